@@ -0,0 +1,945 @@
+/**
+ *******************************************************************************
+ *
+ * @file dma.c
+ *
+ * @brief DMA channel manager and request queues
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#include <zephyr/irq.h>
+#endif
+
+#include <string.h>
+#include "arch.h"
+#include "dma.h"
+#include "at_wrpr.h"
+#include "atm_bp_clock.h"
+#include "at_ahb_dma_regs_core_macro.h"
+
+#ifdef CONFIG_ATM_DMA_IRQ_PRI
+#define DMA_IRQ_PRI CONFIG_ATM_DMA_IRQ_PRI
+#else
+#define DMA_IRQ_PRI 2
+#endif
+
+/// Channel register block; channels repeat every 18 words
+typedef struct {
+    __IO uint32_t OPMODE;
+    __IO uint32_t CONST_WDATA;
+    __IO uint32_t SRC_ADDR;
+    __IO uint32_t TAR_ADDR;
+    __IO uint32_t SIZE;
+    __IO uint32_t SRC_CTRL;
+    __IO uint32_t TAR_CTRL;
+    __IO uint32_t FIFO_DPTH_ADDR;
+    __IO uint32_t FIFO_PORT_SEL;
+    __IO uint32_t SPI_PORT_SEL;
+    __I  uint32_t ERR_STAT;
+    __I  uint32_t STATUS;
+    __I  uint32_t TOTAL_WRITE_REMAINDER;
+    __I  uint32_t INTERRUPT_STATUS;
+    __IO uint32_t INTERRUPT_MASK;
+    __IO uint32_t SET_INTERRUPT;
+    __IO uint32_t RESET_INTERRUPT;
+    __IO uint32_t CFG_HNONSEC;
+} dma_chan_regs_t;
+
+STATIC_ASSERT(sizeof(dma_chan_regs_t) ==
+    offsetof(CMSDK_AT_AHB_DMA_TypeDef, CHAN1_OPMODE), "DMA channel stride");
+STATIC_ASSERT(offsetof(CMSDK_AT_AHB_DMA_TypeDef, ERR_INTERRUPT_DLY) ==
+    (DMA_CHAN_MAX * sizeof(dma_chan_regs_t)), "DMA channel count");
+
+#define DMA_CHAN_REGS(__c) ((dma_chan_regs_t *)&CMSDK_DMA->OPMODE + (__c))
+
+#define DMA_INTRPT_ALL (AT_DMA_INTERRUPT_STATUS__DMA_DONE__MASK | \
+    AT_DMA_INTERRUPT_STATUS__DMA_ERR__MASK)
+
+#define DMA_OPMODE_USER (AT_DMA_OPMODE__CONST_TRANS__MASK | \
+    AT_DMA_OPMODE__DAT_INV__MASK | AT_DMA_OPMODE__CONST_TAR_ADDR__MASK)
+
+typedef struct {
+    dma_req_t *head;
+    dma_req_t *tail;
+    uint8_t depth;
+    bool claimed;
+} dma_chan_t;
+
+static dma_chan_t dma_chans[DMA_CHAN_MAX];
+
+__FAST
+bool dma_can_wait(void)
+{
+    IPSR_Type psr = {.w = __get_IPSR()};
+    // The completion interrupt must be able to preempt the waiter
+    return !psr.b.ISR && !__get_PRIMASK() && !__get_BASEPRI();
+}
+
+/// Program and launch the head request of a channel
+__FAST
+static void dma_start(uint8_t chan)
+{
+    dma_req_t const *req = dma_chans[chan].head;
+    dma_chan_regs_t *regs = DMA_CHAN_REGS(chan);
+
+    regs->SRC_ADDR = req->src;
+    regs->TAR_ADDR = req->tar;
+    regs->SIZE = AT_DMA_SIZE__SIZE__WRITE(req->size);
+    uint8_t width = req->fifo_width ? req->fifo_width : 1;
+    regs->SRC_CTRL = AT_DMA_SRC_CTRL__SRC_TYPE__WRITE(req->src_type) |
+	AT_DMA_SRC_CTRL__SRC_BUS_SIZE__WRITE(width);
+    regs->TAR_CTRL = AT_DMA_TAR_CTRL__TAR_TYPE__WRITE(req->tar_type) |
+	AT_DMA_TAR_CTRL__TAR_BUS_SIZE__WRITE(width);
+    regs->FIFO_DPTH_ADDR = req->fifo_depth;
+    regs->FIFO_PORT_SEL =
+	AT_DMA_FIFO_PORT_SEL__SRC_PORT_SEL__WRITE(req->src_port) |
+	AT_DMA_FIFO_PORT_SEL__TAR_PORT_SEL__WRITE(req->tar_port);
+    regs->SPI_PORT_SEL = AT_DMA_SPI_PORT_SEL__SPI_SEL__WRITE(req->spi_sel);
+    regs->CONST_WDATA = req->const_wdata;
+    regs->RESET_INTERRUPT = DMA_INTRPT_ALL;
+    regs->INTERRUPT_MASK = DMA_INTRPT_ALL;
+
+    // GO is rising edge triggered
+    uint32_t opmode = req->opmode & DMA_OPMODE_USER;
+    regs->OPMODE = opmode;
+    regs->OPMODE = opmode | AT_DMA_OPMODE__GO__MASK;
+}
+
+/// Load the next piece of a chained request; the channel is stopped
+__FAST
+static void dma_rearm(uint8_t chan, dma_req_t const *req)
+{
+    dma_chan_regs_t *regs = DMA_CHAN_REGS(chan);
+
+    regs->SRC_ADDR = req->src;
+    regs->TAR_ADDR = req->tar;
+    regs->SIZE = AT_DMA_SIZE__SIZE__WRITE(req->size);
+
+    uint32_t opmode = req->opmode & DMA_OPMODE_USER;
+    regs->OPMODE = opmode;
+    regs->OPMODE = opmode | AT_DMA_OPMODE__GO__MASK;
+}
+
+__FAST
+static uint8_t dma_chan_pick(uint8_t prio)
+{
+    uint8_t best = DMA_CHAN_MAX;
+
+    for (uint8_t i = 0; i < DMA_CHAN_MAX; i++) {
+	uint8_t chan = (prio == DMA_PRIO_LOW) ? (DMA_CHAN_MAX - 1 - i) : i;
+	dma_chan_t const *c = &dma_chans[chan];
+	if (c->claimed) {
+	    continue;
+	}
+	if (!c->depth) {
+	    return chan;
+	}
+	if ((best == DMA_CHAN_MAX) || (c->depth < dma_chans[best].depth)) {
+	    best = chan;
+	}
+    }
+    ASSERT_INFO(best < DMA_CHAN_MAX, prio, dma_chans[0].claimed);
+    return best;
+}
+
+__FAST
+void dma_submit(dma_req_t *req)
+{
+    ASSERT_INFO(req->size && (req->size <= AT_DMA_SIZE__SIZE__MASK),
+	req->size, req->src);
+    req->next = NULL;
+
+    GLOBAL_INT_DISABLE();
+    uint8_t chan = req->chan;
+    if (chan == DMA_CHAN_ANY) {
+	chan = dma_chan_pick(req->prio);
+    } else {
+	ASSERT_INFO(chan < DMA_CHAN_MAX, chan, req->size);
+    }
+
+    dma_chan_t *c = &dma_chans[chan];
+    c->depth++;
+    if (c->tail) {
+	c->tail->next = req;
+	c->tail = req;
+    } else {
+	c->head = c->tail = req;
+	dma_start(chan);
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+int dma_chan_claim(enum dma_prio prio)
+{
+    int ret = -1;
+    uint8_t shared = 0;
+
+    GLOBAL_INT_DISABLE();
+    for (uint8_t chan = 0; chan < DMA_CHAN_MAX; chan++) {
+	shared += !dma_chans[chan].claimed;
+    }
+    // The last shared channel stays for DMA_CHAN_ANY requests
+    for (uint8_t i = 0; (shared > 1) && (i < DMA_CHAN_MAX); i++) {
+	uint8_t chan = (prio == DMA_PRIO_LOW) ? (DMA_CHAN_MAX - 1 - i) : i;
+	dma_chan_t *c = &dma_chans[chan];
+	if (!c->claimed && !c->depth) {
+	    c->claimed = true;
+	    ret = chan;
+	    break;
+	}
+    }
+    GLOBAL_INT_RESTORE();
+    return ret;
+}
+
+void dma_chan_release(uint8_t chan)
+{
+    ASSERT_INFO(chan < DMA_CHAN_MAX, chan, 0);
+    ASSERT_INFO(!dma_chans[chan].depth, chan, dma_chans[chan].depth);
+    dma_chans[chan].claimed = false;
+}
+
+__FAST
+bool dma_chan_busy(uint8_t chan)
+{
+    return (dma_chans[chan].head != NULL);
+}
+
+__FAST
+__FAST
+uint32_t dma_chan_progress(uint8_t chan)
+{
+    dma_chan_regs_t *regs = DMA_CHAN_REGS(chan);
+    uint32_t moved = 0;
+
+    GLOBAL_INT_DISABLE();
+    dma_req_t const *req = dma_chans[chan].head;
+    if (req) {
+	moved = req->size - (regs->TOTAL_WRITE_REMAINDER &
+	    AT_DMA_TOTAL_WRITE_REMAINDER__TOTAL_WRITE_REMAINDER__MASK);
+    }
+    GLOBAL_INT_RESTORE();
+    return moved;
+}
+
+uint32_t dma_chan_abort(uint8_t chan)
+{
+    dma_chan_regs_t *regs = DMA_CHAN_REGS(chan);
+    dma_chan_t *c = &dma_chans[chan];
+    uint32_t moved = 0;
+
+    GLOBAL_INT_DISABLE();
+    dma_req_t *req = c->head;
+    if (req) {
+	regs->INTERRUPT_MASK = 0;
+	regs->OPMODE = AT_DMA_OPMODE__STOP__MASK;
+	while (regs->STATUS & AT_DMA_STATUS__BUSY__MASK) {
+	    YIELD();
+	}
+	// Remainder is zero when the request completed before the stop
+	moved = req->size - (regs->TOTAL_WRITE_REMAINDER &
+	    AT_DMA_TOTAL_WRITE_REMAINDER__TOTAL_WRITE_REMAINDER__MASK);
+	regs->OPMODE = 0;
+	regs->RESET_INTERRUPT = DMA_INTRPT_ALL;
+
+	c->head = req->next;
+	c->depth--;
+	if (c->head) {
+	    dma_start(chan);
+	} else {
+	    c->tail = NULL;
+	}
+    }
+    GLOBAL_INT_RESTORE();
+    return moved;
+}
+
+__FAST
+static void dma_handler(uint8_t chan)
+{
+    dma_chan_regs_t *regs = DMA_CHAN_REGS(chan);
+    uint32_t status = regs->INTERRUPT_STATUS;
+    regs->RESET_INTERRUPT = status;
+
+    dma_chan_t *c = &dma_chans[chan];
+    dma_req_t *req = c->head;
+    if (!req || !(status & DMA_INTRPT_ALL)) {
+	return;
+    }
+    bool err = (status & AT_DMA_INTERRUPT_STATUS__DMA_ERR__MASK);
+    if (err) {
+	// Abort whatever is left of the payload
+	regs->OPMODE = AT_DMA_OPMODE__STOP__MASK;
+	regs->OPMODE = 0;
+    } else if (req->rearm && req->rearm(req)) {
+	dma_rearm(chan, req);
+	if (req->progress) {
+	    req->progress(req);
+	}
+	return;
+    }
+
+    // Move on before the callback so it may resubmit.
+    c->head = req->next;
+    c->depth--;
+    if (c->head) {
+	dma_start(chan);
+    } else {
+	c->tail = NULL;
+	regs->INTERRUPT_MASK = 0;
+    }
+
+    if (req->cb) {
+	req->cb(req, err);
+    }
+}
+
+/// Fill req with the next piece of the chain
+__FAST
+static bool dma_chain_load(dma_chain_t *chain)
+{
+    dma_req_t *req = &chain->req;
+
+    while (chain->pos < chain->num_segs) {
+	dma_seg_t const *seg = &chain->segs[chain->pos];
+	uint32_t left = seg->size - chain->offset;
+	if (!left) {
+	    chain->pos++;
+	    chain->offset = 0;
+	    continue;
+	}
+
+	uint32_t size = (left > AT_DMA_SIZE__SIZE__MASK) ?
+	    AT_DMA_SIZE__SIZE__MASK : left;
+	req->src = seg->src;
+	if (req->src_type == DMA_TYPE_MEM) {
+	    req->src += chain->offset;
+	}
+	req->tar = seg->tar;
+	if (req->tar_type == DMA_TYPE_MEM) {
+	    req->tar += chain->offset;
+	}
+	req->size = size;
+	chain->offset += size;
+	return true;
+    }
+    return false;
+}
+
+__FAST
+static bool dma_chain_rearm(dma_req_t *req)
+{
+    dma_chain_t *chain = (dma_chain_t *)req;
+
+    chain->done += req->size;
+    return dma_chain_load(chain);
+}
+
+__FAST
+static void dma_chain_done(dma_req_t *req, bool err)
+{
+    dma_chain_t *chain = (dma_chain_t *)req;
+
+    if (!err) {
+	chain->done += req->size;
+    }
+    if (chain->cb) {
+	chain->cb(chain, err);
+    }
+}
+
+STATIC_ASSERT(offsetof(dma_chain_t, req) == 0, "dma_chain_rearm() cast");
+
+void dma_chain_submit(dma_chain_t *chain)
+{
+    chain->pos = 0;
+    chain->offset = 0;
+    chain->done = 0;
+
+    if (!dma_chain_load(chain)) {
+	// Nothing to move; complete right away
+	if (chain->cb) {
+	    chain->cb(chain, false);
+	}
+	return;
+    }
+    chain->req.cb = dma_chain_done;
+    chain->req.rearm = dma_chain_rearm;
+    chain->req.ctx = chain->ctx;
+    dma_submit(&chain->req);
+}
+
+__FAST
+static void dma_sync_done(dma_req_t *req, bool err)
+{
+    ASSERT_INFO(!err, req->src, req->tar);
+    req->ctx = NULL;
+}
+
+/// Run a request to completion; ctx doubles as the pending flag
+static void dma_sync(dma_req_t *req)
+{
+    req->chan = DMA_CHAN_ANY;
+    req->prio = DMA_PRIO_LOW;
+    req->cb = dma_sync_done;
+    req->ctx = req;
+    dma_submit(req);
+    WFI_COND(!req->ctx);
+}
+
+static void dma_hw_copy(void *d, const void *s, size_t n)
+{
+    dma_req_t req = {
+	.src = (uint32_t)s,
+	.tar = (uint32_t)d,
+	.size = n,
+    };
+    dma_sync(&req);
+}
+
+static void dma_hw_set(void *m, int c, size_t n)
+{
+    dma_req_t req = {
+	.tar = (uint32_t)m,
+	.size = n,
+	.opmode = AT_DMA_OPMODE__CONST_TRANS__MASK,
+	.const_wdata = (uint8_t)c * 0x01010101U,
+    };
+    dma_sync(&req);
+}
+
+/*
+ * CPU/DMA crossover points in bytes, valid at dma_xover.freq.  The fixed
+ * DMA cost (set-up, completion interrupt, wake from WFI) is roughly
+ * constant in time, so the bytes the CPU moves meanwhile scale with the
+ * bp clock.  Defaults hold until dma_calibrate() has run.
+ */
+enum {
+    DMA_XOVER_COPY,
+    DMA_XOVER_COPY_UNALIGNED,
+    DMA_XOVER_SET,
+    DMA_XOVER_NUM,
+};
+
+// Crossover meaning "never"; dma_memcpy() falls back above SIZE anyway
+#define DMA_XOVER_NEVER (AT_DMA_SIZE__SIZE__MASK + 1)
+
+static struct {
+    uint32_t freq;
+    uint32_t bytes[DMA_XOVER_NUM];
+} dma_xover = {
+    .bytes = {
+	[DMA_XOVER_COPY] = 128,
+	[DMA_XOVER_COPY_UNALIGNED] = 48,
+	[DMA_XOVER_SET] = 256,
+    },
+};
+
+__FAST
+static bool dma_xover_reached(uint8_t type, size_t n)
+{
+    if (n > AT_DMA_SIZE__SIZE__MASK) {
+	return false;
+    }
+    uint32_t bytes = dma_xover.bytes[type];
+    if (dma_xover.freq) {
+	bytes = ((uint64_t)bytes * atm_bp_clock_get()) / dma_xover.freq;
+    }
+    // The engine cannot move zero bytes
+    return (n >= (bytes ? bytes : 1));
+}
+
+__FAST
+static uint8_t dma_copy_type(void const *d, void const *s)
+{
+    return (((uint32_t)d | (uint32_t)s) & 0x3) ? DMA_XOVER_COPY_UNALIGNED :
+	DMA_XOVER_COPY;
+}
+
+void *dma_memcpy(void *d, const void *s, size_t n)
+{
+    if (!n) {
+	return d;
+    }
+    // Cannot wait for our own interrupt from an ISR or with it masked
+    if (!dma_can_wait() || !dma_xover_reached(dma_copy_type(d, s), n)) {
+	return memcpy(d, s, n);
+    }
+    dma_hw_copy(d, s, n);
+    return d;
+}
+
+void *dma_memset(void *m, int c, size_t n)
+{
+    if (!n) {
+	return m;
+    }
+    if (!dma_can_wait() || !dma_xover_reached(DMA_XOVER_SET, n)) {
+	return memset(m, c, n);
+    }
+    dma_hw_set(m, c, n);
+    return m;
+}
+
+void dma_memcpy_async(dma_req_t *req, void *d, const void *s, size_t n,
+    dma_req_cb_t cb, void const *ctx)
+{
+    *req = (dma_req_t) {
+	.src = (uint32_t)s,
+	.tar = (uint32_t)d,
+	.size = n,
+	.chan = DMA_CHAN_ANY,
+	.prio = DMA_PRIO_LOW,
+	.cb = cb,
+	.ctx = ctx,
+    };
+    if (!n || !dma_xover_reached(dma_copy_type(d, s), n)) {
+	memcpy(d, s, n);
+	if (cb) {
+	    cb(req, false);
+	}
+	return;
+    }
+    dma_submit(req);
+}
+
+void dma_memset_async(dma_req_t *req, void *m, int c, size_t n,
+    dma_req_cb_t cb, void const *ctx)
+{
+    *req = (dma_req_t) {
+	.tar = (uint32_t)m,
+	.size = n,
+	.opmode = AT_DMA_OPMODE__CONST_TRANS__MASK,
+	.const_wdata = (uint8_t)c * 0x01010101U,
+	.chan = DMA_CHAN_ANY,
+	.prio = DMA_PRIO_LOW,
+	.cb = cb,
+	.ctx = ctx,
+    };
+    if (!n || !dma_xover_reached(DMA_XOVER_SET, n)) {
+	memset(m, c, n);
+	if (cb) {
+	    cb(req, false);
+	}
+	return;
+    }
+    dma_submit(req);
+}
+
+#define DMA_CAL_SMALL 16
+#define DMA_CAL_LARGE 256
+
+/// Cycles taken by one operation; best of two to skip cold caches
+static uint32_t dma_cal_cycles(uint8_t type, bool hw, uint8_t *d,
+    uint8_t const *s, size_t n)
+{
+    uint32_t best = UINT32_MAX;
+
+    for (uint8_t i = 0; i < 2; i++) {
+	uint32_t start = DWT->CYCCNT;
+	if (type == DMA_XOVER_SET) {
+	    if (hw) {
+		dma_hw_set(d, 0x5a, n);
+	    } else {
+		memset(d, 0x5a, n);
+	    }
+	} else if (hw) {
+	    dma_hw_copy(d, s, n);
+	} else {
+	    memcpy(d, s, n);
+	}
+	uint32_t cycles = DWT->CYCCNT - start;
+	if (cycles < best) {
+	    best = cycles;
+	}
+    }
+    return best;
+}
+
+/// Fit cost = fixed + slope * n for both engines (8.8 fixed point)
+static uint32_t dma_cal_xover(uint8_t type, uint8_t *d, uint8_t const *s)
+{
+    int32_t span = DMA_CAL_LARGE - DMA_CAL_SMALL;
+    int32_t cpu_s = dma_cal_cycles(type, false, d, s, DMA_CAL_SMALL);
+    int32_t cpu_l = dma_cal_cycles(type, false, d, s, DMA_CAL_LARGE);
+    int32_t hw_s = dma_cal_cycles(type, true, d, s, DMA_CAL_SMALL);
+    int32_t hw_l = dma_cal_cycles(type, true, d, s, DMA_CAL_LARGE);
+
+    int32_t cpu_slope = ((cpu_l - cpu_s) << 8) / span;
+    int32_t hw_slope = ((hw_l - hw_s) << 8) / span;
+    if (cpu_slope <= hw_slope) {
+	return DMA_XOVER_NEVER;
+    }
+    int32_t cpu_fixed = (cpu_s << 8) - (cpu_slope * DMA_CAL_SMALL);
+    int32_t hw_fixed = (hw_s << 8) - (hw_slope * DMA_CAL_SMALL);
+    // At least one byte: zero sized transfers never reach the engine
+    if (hw_fixed <= cpu_fixed) {
+	return 1;
+    }
+    uint32_t xover = (hw_fixed - cpu_fixed) / (cpu_slope - hw_slope);
+    return xover ? xover : 1;
+}
+
+void dma_calibrate(void)
+{
+    // One spare byte so the unaligned run stays in bounds
+    uint32_t buf[2][(DMA_CAL_LARGE / sizeof(uint32_t)) + 1];
+    uint8_t *d = (uint8_t *)buf[0];
+    uint8_t const *s = (uint8_t const *)buf[1];
+
+    ASSERT_INFO(dma_can_wait(), d, s);
+    memset(buf[1], 0xa5, sizeof(buf[1]));
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    uint32_t freq = atm_bp_clock_get();
+    uint32_t copy = dma_cal_xover(DMA_XOVER_COPY, d, s);
+    uint32_t unaligned = dma_cal_xover(DMA_XOVER_COPY_UNALIGNED, d + 1, s);
+    uint32_t set = dma_cal_xover(DMA_XOVER_SET, d, s);
+
+    GLOBAL_INT_DISABLE();
+    dma_xover.bytes[DMA_XOVER_COPY] = copy;
+    dma_xover.bytes[DMA_XOVER_COPY_UNALIGNED] = unaligned;
+    dma_xover.bytes[DMA_XOVER_SET] = set;
+    dma_xover.freq = freq;
+    GLOBAL_INT_RESTORE();
+}
+
+void dma_copy(uint8_t channel, void *p_dst_addr, const void *p_src_addr,
+    uint16_t size)
+{
+    static dma_req_t dma_copy_req[DMA_CHAN_MAX];
+
+    ASSERT_INFO(channel < DMA_CHAN_MAX, channel, size);
+    if (!size) {
+	return;
+    }
+    dma_req_t *req = &dma_copy_req[channel];
+    // One copy in flight per channel, as before
+    for (;;) {
+	bool idle = false;
+
+	GLOBAL_INT_DISABLE();
+	if (!req->ctx) {
+	    req->ctx = req;
+	    idle = true;
+	}
+	GLOBAL_INT_RESTORE();
+	if (idle) {
+	    break;
+	}
+	// Cannot wait for our own interrupt from an ISR or with it masked
+	if (!dma_can_wait()) {
+	    memcpy(p_dst_addr, p_src_addr, size);
+	    return;
+	}
+	WFI_COND(!req->ctx);
+    }
+
+    *req = (dma_req_t) {
+	.src = (uint32_t)p_src_addr,
+	.tar = (uint32_t)p_dst_addr,
+	.size = size,
+	.chan = channel,
+	.prio = DMA_PRIO_LOW,
+	.cb = dma_sync_done,
+	.ctx = req,
+    };
+    GLOBAL_INT_DISABLE();
+    // A claimed channel runs a request that never ends; queue elsewhere
+    if (dma_chans[channel].claimed) {
+	req->chan = DMA_CHAN_ANY;
+    }
+    dma_submit(req);
+    GLOBAL_INT_RESTORE();
+}
+
+void dma_fifo_rx_req(enum dma_fifo_rx_port port, dma_req_t *req)
+{
+    req->src_type = DMA_TYPE_FIFO;
+    req->src_port = port;
+    switch (port) {
+	case DMA_FIFO_RX_UART0:
+	    req->src = (uint32_t)&CMSDK_AT_UART0->DATA;
+	    req->fifo_depth = (uint32_t)&CMSDK_AT_UART0->RX_FIFO_ENTRIES;
+	    break;
+	case DMA_FIFO_RX_UART1:
+	    req->src = (uint32_t)&CMSDK_UART1->DATA;
+	    req->fifo_depth = (uint32_t)&CMSDK_UART1->RX_FIFO_ENTRIES;
+	    break;
+	case DMA_FIFO_RX_PDM0:
+	    req->src = CMSDK_AHB_PDM_PP_BASE;
+	    req->fifo_depth = (uint32_t)&CMSDK_PDM->BUFFER_DEPTH;
+	    break;
+	case DMA_FIFO_RX_PDM1:
+	    req->src = CMSDK_PDM1_PP_NONSECURE_BASE;
+	    req->fifo_depth = (uint32_t)&CMSDK_PDM1_NONSECURE->BUFFER_DEPTH;
+	    break;
+	case DMA_FIFO_RX_I2S:
+	    req->src = (uint32_t)&CMSDK_I2S->I2S_PP1_RDATA;
+	    req->fifo_depth = (uint32_t)&CMSDK_I2S->BUFFER_DEPTH;
+	    break;
+	default:
+	    ASSERT_INFO(0, port, req);
+	    break;
+    }
+}
+
+void dma_fifo_tx_req(enum dma_fifo_tx_port port, dma_req_t *req)
+{
+    req->tar_type = DMA_TYPE_FIFO;
+    req->tar_port = port;
+    switch (port) {
+	case DMA_FIFO_TX_UART0:
+	    req->tar = (uint32_t)&CMSDK_AT_UART0->DATA;
+	    req->fifo_depth = (uint32_t)&CMSDK_AT_UART0->TX_FIFO_SPACES;
+	    break;
+	case DMA_FIFO_TX_UART1:
+	    req->tar = (uint32_t)&CMSDK_UART1->DATA;
+	    req->fifo_depth = (uint32_t)&CMSDK_UART1->TX_FIFO_SPACES;
+	    break;
+	case DMA_FIFO_TX_I2S:
+	    req->tar = (uint32_t)&CMSDK_I2S->I2S_PP0_WDATA;
+	    req->fifo_depth = (uint32_t)&CMSDK_I2S->PP_ST;
+	    break;
+	case DMA_FIFO_TX_PWM:
+	    req->tar = (uint32_t)&CMSDK_PWM->FIFO_DATA;
+	    req->fifo_depth = (uint32_t)&CMSDK_PWM->FIFO_STAT1;
+	    break;
+	default:
+	    ASSERT_INFO(0, port, req);
+	    break;
+    }
+}
+
+/// Legacy dma_cb_t completion, one outstanding transfer per port
+typedef struct {
+    dma_req_t req;
+    dma_cb_t cb;
+    bool volatile busy;
+} dma_fifo_slot_t;
+
+STATIC_ASSERT(offsetof(dma_fifo_slot_t, req) == 0, "dma_fifo_done() cast");
+
+static dma_fifo_slot_t dma_fifo_rx_slot[DMA_FIFO_RX_RSVD];
+static dma_fifo_slot_t dma_fifo_tx_slot[DMA_FIFO_TX_PWM + 1];
+
+__FAST
+static void dma_fifo_done(dma_req_t *req, bool err)
+{
+    dma_fifo_slot_t *slot = (dma_fifo_slot_t *)req;
+    dma_cb_t cb = slot->cb;
+
+    ASSERT_INFO(!err, req->src, req->tar);
+    // Free before the callback so it may submit the next transfer
+    slot->busy = false;
+    if (cb) {
+	cb(req->ctx);
+    }
+}
+
+static bool dma_fifo_submit(dma_fifo_slot_t *slot, dma_req_t const *req,
+    dma_cb_t cb)
+{
+    for (;;) {
+	bool claimed = false;
+
+	GLOBAL_INT_DISABLE();
+	if (!slot->busy) {
+	    slot->busy = true;
+	    claimed = true;
+	}
+	GLOBAL_INT_RESTORE();
+	if (claimed) {
+	    break;
+	}
+	if (!dma_can_wait()) {
+	    return false;
+	}
+	WFI_COND(!slot->busy);
+    }
+    slot->req = *req;
+    slot->req.chan = DMA_CHAN_ANY;
+    // Streaming peripherals overflow; keep them on the winning channels
+    slot->req.prio = DMA_PRIO_HIGH;
+    slot->req.cb = dma_fifo_done;
+    slot->cb = cb;
+    dma_submit(&slot->req);
+    return true;
+}
+
+bool dma_fifo_rx_try(enum dma_fifo_rx_port port, void *dst, size_t len,
+    dma_cb_t cb, void const *ctx)
+{
+    ASSERT_INFO(port < DMA_FIFO_RX_RSVD, port, len);
+    dma_req_t req = {
+	.tar = (uint32_t)dst,
+	.size = len,
+	.tar_type = DMA_TYPE_MEM,
+	.ctx = ctx,
+    };
+    dma_fifo_rx_req(port, &req);
+    return dma_fifo_submit(&dma_fifo_rx_slot[port], &req, cb);
+}
+
+bool dma_fifo_tx_try(enum dma_fifo_tx_port port, const void *src, size_t len,
+    dma_cb_t cb, void const *ctx)
+{
+    ASSERT_INFO((port <= DMA_FIFO_TX_PWM) && (port != DMA_FIFO_TX_RSVD) &&
+	(port != DMA_FIFO_TX_RSVD1), port, len);
+    dma_req_t req = {
+	.src = (uint32_t)src,
+	.size = len,
+	.src_type = DMA_TYPE_MEM,
+	.ctx = ctx,
+    };
+    dma_fifo_tx_req(port, &req);
+    return dma_fifo_submit(&dma_fifo_tx_slot[port], &req, cb);
+}
+
+void dma_fifo_rx_async(enum dma_fifo_rx_port port, void *dst, size_t len,
+    dma_cb_t cb, void const *ctx)
+{
+    if (!dma_fifo_rx_try(port, dst, len, cb, ctx)) {
+	ASSERT_INFO(0, port, len);
+    }
+}
+
+void dma_fifo_tx_async(enum dma_fifo_tx_port port, const void *src, size_t len,
+    dma_cb_t cb, void const *ctx)
+{
+    if (!dma_fifo_tx_try(port, src, len, cb, ctx)) {
+	ASSERT_INFO(0, port, len);
+    }
+}
+
+bool dma_is_active(uint32_t *min_freq)
+{
+    for (uint8_t chan = 0; chan < DMA_CHAN_MAX; chan++) {
+	if (dma_chans[chan].head) {
+	    return true;
+	}
+    }
+    return false;
+}
+
+void dma_init(void)
+{
+    WRPR_CTRL_SET(CMSDK_DMA, WRPR_CTRL__CLK_ENABLE);
+    // Lower numbered channel wins the bus (DMA_PRIO_HIGH picks from 0 up)
+    CMSDK_DMA->ARBITER_CTRL = AT_DMA_ARBITER_CTRL__PRIORITY_EN__WRITE(1);
+    for (uint8_t chan = 0; chan < DMA_CHAN_MAX; chan++) {
+	dma_chan_regs_t *regs = DMA_CHAN_REGS(chan);
+	regs->INTERRUPT_MASK = 0;
+	regs->RESET_INTERRUPT = DMA_INTRPT_ALL;
+	if (dma_chans[chan].head) {
+	    // Transfers do not survive retention; run what is queued again
+	    dma_start(chan);
+	}
+    }
+}
+
+__FAST
+static rep_vec_err_t dma_back_from_retain_all(void)
+{
+    dma_init();
+    return RV_NEXT;
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static void dma0_isr(void const *arg)
+{
+    dma_handler(0);
+}
+
+static void dma1_isr(void const *arg)
+{
+    dma_handler(1);
+}
+
+static void dma2_isr(void const *arg)
+{
+    dma_handler(2);
+}
+
+static void dma3_isr(void const *arg)
+{
+    dma_handler(3);
+}
+#else
+void DMA0_Handler(void)
+{
+    dma_handler(0);
+}
+
+void DMA1_Handler(void)
+{
+    dma_handler(1);
+}
+
+void DMA2_Handler(void)
+{
+    dma_handler(2);
+}
+
+void DMA3_Handler(void)
+{
+    dma_handler(3);
+}
+#endif
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_DMA)
+#endif
+static void dma_constructor(void)
+{
+#if PLF_DMA
+    // Data path owns channel 0; it never enters the shared pool
+    dma_chans[DMA_CHAN_DATA_PATH].claimed = true;
+#endif
+    dma_init();
+    RV_PLF_BACK_FROM_RETAIN_ALL_ADD(dma_back_from_retain_all);
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+    IRQ_CONNECT(DMA0_IRQn, DMA_IRQ_PRI, dma0_isr, NULL, 0);
+    IRQ_CONNECT(DMA1_IRQn, DMA_IRQ_PRI, dma1_isr, NULL, 0);
+    IRQ_CONNECT(DMA2_IRQn, DMA_IRQ_PRI, dma2_isr, NULL, 0);
+    IRQ_CONNECT(DMA3_IRQn, DMA_IRQ_PRI, dma3_isr, NULL, 0);
+    irq_enable(DMA0_IRQn);
+    irq_enable(DMA1_IRQn);
+    irq_enable(DMA2_IRQn);
+    irq_enable(DMA3_IRQn);
+#else
+    NVIC_EnableIRQ(DMA0_IRQn);
+    NVIC_EnableIRQ(DMA1_IRQn);
+    NVIC_EnableIRQ(DMA2_IRQn);
+    NVIC_EnableIRQ(DMA3_IRQn);
+#endif
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int dma_sys_init(void)
+{
+    dma_constructor();
+    return 0;
+}
+
+SYS_INIT(dma_sys_init, PRE_KERNEL_2, 2);
+
+static int dma_calibrate_sys_init(void)
+{
+    // Needs interrupts and a thread context
+    dma_calibrate();
+    return 0;
+}
+
+SYS_INIT(dma_calibrate_sys_init, APPLICATION,
+    CONFIG_APPLICATION_INIT_PRIORITY);
+#endif
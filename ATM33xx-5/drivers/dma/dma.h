@@ -29,6 +29,8 @@
  * INCLUDES
  ****************************************************************************************
  */
+#include <stdbool.h>
+#include <stddef.h>
 #include <stdint.h>
 
 /*
@@ -43,10 +45,16 @@ enum dma_channels
     DMA_CHAN_DATA_PATH = 0,
     /// DMA Channel available for other operation
     DMA_CHAN_UNUSED,
+    /// DMA Channels available for other operation
+    DMA_CHAN_2,
+    DMA_CHAN_3,
 
     DMA_CHAN_MAX,
 };
 
+/// Let the driver pick an unclaimed channel
+#define DMA_CHAN_ANY 0xff
+
 enum dma_fifo_rx_port {
     DMA_FIFO_RX_UART0 = 0,
     DMA_FIFO_RX_UART1 = 1,
@@ -67,23 +75,222 @@ enum dma_fifo_tx_port {
 
 typedef void (*dma_cb_t)(void const *ctx);
 
+/// Transfer endpoint (SRC_TYPE/TAR_TYPE encoding)
+enum dma_type {
+    DMA_TYPE_MEM = 0,
+    DMA_TYPE_FIFO = 1,
+    DMA_TYPE_PERIPH_MASTER = 2,
+    DMA_TYPE_PERIPH_SLAVE = 3,
+};
+
+/// Channel preference; lower numbered channels win bus arbitration
+enum dma_prio {
+    DMA_PRIO_HIGH,
+    DMA_PRIO_LOW,
+};
+
+struct dma_req;
+
+/**
+ * @brief Request completion callback (called from interrupt context)
+ * @param[in] req Completed request
+ * @param[in] err Transfer ended with an error
+ */
+typedef void (*dma_req_cb_t)(struct dma_req *req, bool err);
+
+/// Transfer request, owned by the driver from submission to completion
+typedef struct dma_req {
+    /// Source address (memory or peripheral register)
+    uint32_t src;
+    /// Target address (memory or peripheral register)
+    uint32_t tar;
+    /// Payload size in bytes (24 bits)
+    uint32_t size;
+    /// Source endpoint (@see enum dma_type)
+    uint8_t src_type;
+    /// Target endpoint (@see enum dma_type)
+    uint8_t tar_type;
+    /// FIFO source port (@see enum dma_fifo_rx_port)
+    uint8_t src_port;
+    /// FIFO target port (@see enum dma_fifo_tx_port)
+    uint8_t tar_port;
+    /// FIFO access width in bytes (1 to 4, 0 means 1)
+    uint8_t fifo_width;
+    /// Peripheral master: 0=SPI0 1=SPI1
+    uint8_t spi_sel;
+    /// Channel preference (@see enum dma_prio)
+    uint8_t prio;
+    /// DMA_CHAN_ANY, or a channel claimed with dma_chan_claim()
+    uint8_t chan;
+    /// Address of the FIFO fill level register
+    uint32_t fifo_depth;
+    /// Extra OPMODE bits (CONST_TRANS, DAT_INV, CONST_TAR_ADDR)
+    uint32_t opmode;
+    /// Value written in CONST_TRANS mode
+    uint32_t const_wdata;
+    /// Completion callback (optional)
+    dma_req_cb_t cb;
+    /// Callback context
+    void const *ctx;
+    /**
+     * Re-arm hook (optional), called from the DONE interrupt.  Load the
+     * next piece into src/tar/size and return true to run it on the same
+     * channel ahead of any queued request.
+     */
+    bool (*rearm)(struct dma_req *req);
+    /// Called once a re-arm has been issued (optional)
+    void (*progress)(struct dma_req *req);
+    /// @cond PRIVATE
+    struct dma_req *next;
+    /// @endcond
+} dma_req_t;
+
+/// Scatter-gather segment
+typedef struct {
+    /// Source address; FIFO and peripheral sources are not advanced
+    uint32_t src;
+    /// Target address; FIFO and peripheral targets are not advanced
+    uint32_t tar;
+    /// Segment size in bytes (any size; split at the 24 bit SIZE limit)
+    uint32_t size;
+} dma_seg_t;
+
+struct dma_chain;
+
+/**
+ * @brief Chain completion callback (called from interrupt context)
+ * @param[in] chain Completed chain
+ * @param[in] err   A segment ended with an error; the rest were skipped
+ */
+typedef void (*dma_chain_cb_t)(struct dma_chain *chain, bool err);
+
+/// Scatter-gather chain
+typedef struct dma_chain {
+    /**
+     * Endpoint types, ports, channel and priority of every segment.
+     * src, tar, size, cb, ctx and rearm are managed by the chain.
+     */
+    dma_req_t req;
+    /// Segment list; must stay valid until the callback runs
+    dma_seg_t const *segs;
+    /// Number of segments
+    uint16_t num_segs;
+    /// Completion callback (optional)
+    dma_chain_cb_t cb;
+    /// Callback context
+    void const *ctx;
+    /// Bytes transferred so far
+    uint32_t done;
+    /// @cond PRIVATE
+    uint16_t pos;
+    uint32_t offset;
+    /// @endcond
+} dma_chain_t;
+
 /*
  * FUNCTION DECLARATIONS
  ****************************************************************************************
  */
 
+/**
+ * @brief Copy memory, by DMA when that is faster (blocking).
+ *
+ * Copies shorter than the calibrated crossover for the current bp clock
+ * and alignment, and all calls that cannot wait for the completion
+ * interrupt (@see dma_can_wait), use the CPU.
+ */
 void *dma_memcpy(void *d, const void *s, size_t n);
+
+/**
+ * @brief Fill memory, by DMA (CONST_TRANS) when that is faster (blocking).
+ */
 void *dma_memset(void *m, int c, size_t n);
 
+/**
+ * @brief Copy memory without waiting.
+ *
+ * Below the crossover the copy is done by the CPU and cb runs before
+ * this returns.
+ * @param[out] req Request storage; must stay valid until cb runs.
+ * @param[in]  d   Destination.
+ * @param[in]  s   Source.
+ * @param[in]  n   Size in bytes.
+ * @param[in]  cb  Completion callback (optional).
+ * @param[in]  ctx Callback context.
+ */
+void dma_memcpy_async(dma_req_t *req, void *d, const void *s, size_t n,
+    dma_req_cb_t cb, void const *ctx);
+
+/**
+ * @brief Fill memory without waiting (@see dma_memcpy_async).
+ */
+void dma_memset_async(dma_req_t *req, void *m, int c, size_t n,
+    dma_req_cb_t cb, void const *ctx);
+
+/**
+ * @brief Measure CPU and DMA copy/fill costs to set the crossover points.
+ *
+ * Run from thread context with interrupts enabled.  Zephyr builds run it
+ * at APPLICATION init level; otherwise built-in defaults apply until the
+ * application calls it.
+ */
+void dma_calibrate(void);
+
+/**
+ * @brief Read from a FIFO port without waiting for the data.
+ *
+ * One transfer per port at a time; a second call waits for the first to
+ * complete.  Where that wait is not possible (@see dma_can_wait) the call
+ * asserts; use dma_fifo_rx_try() there instead.
+ * @param[in]  port FIFO port.
+ * @param[out] dst  Destination; must stay valid until cb runs.
+ * @param[in]  len  Size in bytes.
+ * @param[in]  cb   Completion callback (optional).
+ * @param[in]  ctx  Callback context.
+ */
 void dma_fifo_rx_async(enum dma_fifo_rx_port port, void *dst, size_t len,
     dma_cb_t cb, void const *ctx);
+
+/**
+ * @brief Write to a FIFO port without waiting (@see dma_fifo_rx_async).
+ */
 void dma_fifo_tx_async(enum dma_fifo_tx_port port, const void *src, size_t len,
     dma_cb_t cb, void const *ctx);
 
+/**
+ * @brief Read from a FIFO port without waiting (@see dma_fifo_rx_async).
+ * @return false if the port was busy and the caller cannot wait
+ * (@see dma_can_wait); nothing was queued.
+ */
+bool dma_fifo_rx_try(enum dma_fifo_rx_port port, void *dst, size_t len,
+    dma_cb_t cb, void const *ctx);
+
+/**
+ * @brief Write to a FIFO port without waiting (@see dma_fifo_rx_try).
+ */
+bool dma_fifo_tx_try(enum dma_fifo_tx_port port, const void *src, size_t len,
+    dma_cb_t cb, void const *ctx);
+
+/**
+ * @brief Fill in the source side of a request for a FIFO port.
+ * @param[in]     port FIFO port.
+ * @param[in,out] req  Request; src, src_type, src_port and fifo_depth are set.
+ */
+void dma_fifo_rx_req(enum dma_fifo_rx_port port, dma_req_t *req);
+
+/**
+ * @brief Fill in the target side of a request for a FIFO port.
+ * @param[in]     port FIFO port.
+ * @param[in,out] req  Request; tar, tar_type, tar_port and fifo_depth are set.
+ */
+void dma_fifo_tx_req(enum dma_fifo_tx_port port, dma_req_t *req);
+
 /**
  * @brief Request an address to address memory copy using a DMA block (non blocking).
  *
  * If this function is called while DMA channel is in use, function is blocked till DMA channel is released
+ * (copied by the CPU instead where blocking is not possible).  A channel held
+ * through dma_chan_claim() is passed over for any shared one.
  *
  * @param[in] channel       DMA channel used (@see enum dma_channels)
  * @param[in] p_dst_addr    Destination address of the memory copy
@@ -92,6 +299,74 @@ void dma_fifo_tx_async(enum dma_fifo_tx_port port, const void *src, size_t len,
  */
 void dma_copy(uint8_t channel, void* p_dst_addr, const void* p_src_addr, uint16_t size);
 
+/**
+ * @brief Queue a transfer request (non blocking).
+ *
+ * With req->chan set to DMA_CHAN_ANY the request goes to an idle unclaimed
+ * channel, searched from channel 0 up for DMA_PRIO_HIGH and from the last
+ * channel down for DMA_PRIO_LOW, or else to the shortest queue.  Requests
+ * on a channel run in submission order.
+ * @param[in] req Request; must stay valid until its callback runs.
+ */
+void dma_submit(dma_req_t *req);
+
+/**
+ * @brief Queue a scatter-gather chain (non blocking).
+ *
+ * The chain occupies one channel for its whole length.  Each segment is
+ * loaded from the DONE interrupt of the previous one, so fragmented
+ * buffers need not be flattened first.
+ * @param[in] chain Chain; must stay valid until its callback runs.
+ */
+void dma_chain_submit(dma_chain_t *chain);
+
+/**
+ * @brief Claim a channel for exclusive use.
+ *
+ * The last unclaimed channel is never handed out, so DMA_CHAN_ANY
+ * requests always have a channel to go to.
+ * @param[in] prio Channel preference (@see enum dma_prio)
+ * @return Channel number, or -1 if no idle channel can be spared.
+ */
+int dma_chan_claim(enum dma_prio prio);
+
+/**
+ * @brief Return a claimed channel to the shared pool.
+ * @param[in] chan Channel from dma_chan_claim(); must be idle.
+ */
+void dma_chan_release(uint8_t chan);
+
+/**
+ * @brief Check for queued or running requests on a channel.
+ * @param[in] chan Channel number.
+ * @return true while requests are pending.
+ */
+bool dma_chan_busy(uint8_t chan);
+
+/**
+ * @brief Check the progress of the running request of a channel.
+ * @param[in] chan Channel number.
+ * @return Bytes written so far by the running request, 0 if none.
+ */
+uint32_t dma_chan_progress(uint8_t chan);
+
+/**
+ * @brief Stop the running request of a channel.
+ *
+ * The request is dropped without its callback and the next queued one, if
+ * any, is started.
+ * @param[in] chan Channel number.
+ * @return Bytes written by the stopped request.
+ */
+uint32_t dma_chan_abort(uint8_t chan);
+
+/**
+ * @brief Check whether the caller can wait for a DMA completion.
+ * @return false from interrupt context or with interrupts masked
+ * (PRIMASK or BASEPRI).
+ */
+bool dma_can_wait(void);
+
 /**
  * @brief Fetch power management status
  * @param[in,out] min_freq  Minimum frequency required by pending operations
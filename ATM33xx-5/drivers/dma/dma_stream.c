@@ -0,0 +1,219 @@
+/**
+ *******************************************************************************
+ *
+ * @file dma_stream.c
+ *
+ * @brief Circular ping-pong DMA capture from PDM and I2S, playback to I2S
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#include "arch.h"
+#include "dma.h"
+#include "dma_stream.h"
+#include "at_apb_pdm_regs_core_macro.h"
+#include "at_i2s_regs_core_macro.h"
+
+STATIC_ASSERT(offsetof(dma_stream_t, req) == 0, "dma_stream_rearm() cast");
+
+// I2S capture and playback share DMA_EN
+static uint8_t dma_stream_i2s_users;
+
+/// Called from dma_stream_done() in interrupt context as well
+__FAST
+static void dma_stream_port_dma(dma_stream_t const *stream, bool enable)
+{
+    // User count and register RMW must not interleave with the ISR
+    GLOBAL_INT_DISABLE();
+    // Playback is I2S only
+    switch (stream->play ? DMA_FIFO_RX_I2S : stream->port) {
+	case DMA_FIFO_RX_PDM0:
+	    PDM_BUFFER_ACCESS_MODE__DMA_MODE__MODIFY(
+		CMSDK_PDM->BUFFER_ACCESS_MODE, enable);
+	    break;
+	case DMA_FIFO_RX_PDM1:
+	    PDM_BUFFER_ACCESS_MODE__DMA_MODE__MODIFY(
+		CMSDK_PDM1_NONSECURE->BUFFER_ACCESS_MODE, enable);
+	    break;
+	case DMA_FIFO_RX_I2S:
+	    dma_stream_i2s_users += enable ? 1 : -1;
+	    ATI2S_I2S_CTRL0__DMA_EN__MODIFY(CMSDK_I2S->I2S_CTRL0,
+		dma_stream_i2s_users != 0);
+	    break;
+	default:
+	    ASSERT_INFO(0, stream->port, enable);
+	    break;
+    }    GLOBAL_INT_RESTORE();
+}
+
+/// Pass the half that just completed to the application
+__FAST
+static void dma_stream_deliver(dma_stream_t *stream, uint8_t filled)
+{
+    stream->held |= 1 << filled;
+    stream->stats.halves++;
+    stream->cb(stream, stream->buf + (filled * stream->half_len),
+	stream->half_len, filled);
+}
+
+__FAST
+static bool dma_stream_rearm(dma_req_t *req)
+{
+    dma_stream_t *stream = (dma_stream_t *)req;
+
+    stream->half ^= 1;
+    if (stream->stop) {
+	return false;
+    }
+    if (stream->held & (1 << stream->half)) {
+	// Application is late; the hardware cannot wait for it
+	stream->stats.overruns++;
+	stream->held &= ~(1 << stream->half);
+    }
+    uint32_t addr = (uint32_t)stream->buf + (stream->half * stream->half_len);
+    if (stream->play) {
+	req->src = addr;
+    } else {
+	req->tar = addr;
+    }
+    return true;
+}
+
+__FAST
+static void dma_stream_progress(dma_req_t *req)
+{
+    dma_stream_t *stream = (dma_stream_t *)req;
+
+    dma_stream_deliver(stream, stream->half ^ 1);
+}
+
+__FAST
+static void dma_stream_done(dma_req_t *req, bool err)
+{
+    dma_stream_t *stream = (dma_stream_t *)req;
+
+    dma_stream_port_dma(stream, false);
+    dma_chan_release(req->chan);
+    stream->running = false;
+
+    if (err) {
+	stream->stats.errors++;
+	return;
+    }
+    // rearm() already flipped to the half that would have come next
+    dma_stream_deliver(stream, stream->half ^ 1);
+}
+
+bool dma_stream_start(dma_stream_t *stream, enum dma_fifo_rx_port port,
+    uint8_t *buf, uint32_t len, dma_stream_cb_t cb, void const *ctx)
+{
+    ASSERT_INFO((port == DMA_FIFO_RX_PDM0) || (port == DMA_FIFO_RX_PDM1) ||
+	(port == DMA_FIFO_RX_I2S), port, len);
+    ASSERT_INFO(len && !(len & 0x7) && !((uint32_t)buf & 0x3), buf, len);
+    ASSERT_INFO(!stream->running, stream, port);
+
+    // A never ending request must not have others queued behind it
+    int chan = dma_chan_claim(DMA_PRIO_HIGH);
+    if (chan < 0) {
+	return false;
+    }
+
+    *stream = (dma_stream_t) {
+	.req = {
+	    .tar = (uint32_t)buf,
+	    .size = len / 2,
+	    .tar_type = DMA_TYPE_MEM,
+	    .fifo_width = 4,
+	    .chan = chan,
+	    .cb = dma_stream_done,
+	    .rearm = dma_stream_rearm,
+	    .progress = dma_stream_progress,
+	},
+	.buf = buf,
+	.half_len = len / 2,
+	.cb = cb,
+	.port = port,
+	.running = true,
+	.ctx = ctx,
+    };
+    dma_fifo_rx_req(port, &stream->req);
+
+    dma_stream_port_dma(stream, true);
+    dma_submit(&stream->req);
+    return true;
+}
+
+bool dma_stream_play(dma_stream_t *stream, enum dma_fifo_tx_port port,
+    uint8_t *buf, uint32_t len, dma_stream_cb_t cb, void const *ctx)
+{
+    ASSERT_INFO(port == DMA_FIFO_TX_I2S, port, len);
+    ASSERT_INFO(len && !(len & 0x7) && !((uint32_t)buf & 0x3), buf, len);
+    ASSERT_INFO(!stream->running, stream, port);
+
+    int chan = dma_chan_claim(DMA_PRIO_HIGH);
+    if (chan < 0) {
+	return false;
+    }
+
+    *stream = (dma_stream_t) {
+	.req = {
+	    .src = (uint32_t)buf,
+	    .size = len / 2,
+	    .src_type = DMA_TYPE_MEM,
+	    .fifo_width = 4,
+	    .chan = chan,
+	    .cb = dma_stream_done,
+	    .rearm = dma_stream_rearm,
+	    .progress = dma_stream_progress,
+	},
+	.buf = buf,
+	.half_len = len / 2,
+	.cb = cb,
+	.port = port,
+	.play = true,
+	.running = true,
+	.ctx = ctx,
+    };
+    dma_fifo_tx_req(port, &stream->req);
+
+    dma_stream_port_dma(stream, true);
+    dma_submit(&stream->req);
+    return true;
+}
+
+__FAST
+void dma_stream_release(dma_stream_t *stream, uint8_t const *buf)
+{
+    uint8_t half = (buf != stream->buf);
+
+    ASSERT_INFO(buf == (stream->buf + (half * stream->half_len)), buf,
+	stream->buf);
+    GLOBAL_INT_DISABLE();
+    stream->held &= ~(1 << half);
+    GLOBAL_INT_RESTORE();
+}
+
+void dma_stream_stop(dma_stream_t *stream)
+{
+    stream->stop = true;
+}
+
+void dma_stream_abort(dma_stream_t *stream)
+{
+    GLOBAL_INT_DISABLE();
+    if (stream->running) {
+	stream->stop = true;
+	dma_chan_abort(stream->req.chan);
+	dma_stream_port_dma(stream, false);
+	dma_chan_release(stream->req.chan);
+	stream->running = false;
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+bool dma_stream_running(dma_stream_t const *stream)
+{
+    return stream->running;
+}
@@ -0,0 +1,148 @@
+/**
+ *******************************************************************************
+ *
+ * @file dma_stream.h
+ *
+ * @brief Circular ping-pong DMA capture from PDM and I2S, playback to I2S
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup DMA_STREAM DMA capture and playback streams
+ * @ingroup DRIVERS
+ * @brief Continuous FIFO transfers through a buffer split in two halves.
+ *
+ * The stream owns a DMA channel while it runs.  Each half is re-armed from
+ * the DONE interrupt of the other, before the application is told about
+ * the half that just completed, so callback latency never delays the DMA.
+ * Halves are handed out in place (no copies) and returned with
+ * dma_stream_release(): filled halves for capture, played halves to be
+ * refilled for playback.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct dma_stream;
+
+/**
+ * @brief Completed half notification (called from interrupt context)
+ * @param[in] stream Stream
+ * @param[in] buf    Filled (capture) or played (playback) half, owned by
+ *                   the application until released
+ * @param[in] len    Half size in bytes
+ * @param[in] full   false for the first half, true for the second
+ */
+typedef void (*dma_stream_cb_t)(struct dma_stream *stream, uint8_t *buf,
+    uint32_t len, bool full);
+
+/// Stream statistics
+typedef struct dma_stream_stats_s {
+    /// Halves completed
+    uint32_t halves;
+    /// Halves reused by the DMA while still held by the application
+    uint32_t overruns;
+    /// DMA errors (the stream stops)
+    uint32_t errors;
+} dma_stream_stats_t;
+
+/// Stream state
+typedef struct dma_stream {
+    /// @cond PRIVATE
+    dma_req_t req;
+    uint8_t *buf;
+    uint32_t half_len;
+    dma_stream_cb_t cb;
+    uint8_t port;
+    uint8_t half;
+    uint8_t held;
+    bool play;
+    bool stop;
+    bool running;
+    /// @endcond
+    /// Statistics since dma_stream_start()
+    dma_stream_stats_t stats;
+    /// Application context
+    void const *ctx;
+} dma_stream_t;
+
+/**
+ * @brief Start a continuous capture.
+ *
+ * PDM ports are switched to DMA_MODE and I2S to DMA_EN; the rest of the
+ * peripheral set-up is left to the caller.
+ * @param[out] stream Stream state; must stay valid while running.
+ * @param[in]  port   DMA_FIFO_RX_PDM0, DMA_FIFO_RX_PDM1 or DMA_FIFO_RX_I2S.
+ * @param[in]  buf    Capture buffer, word aligned.
+ * @param[in]  len    Buffer size in bytes; a multiple of 8.
+ * @param[in]  cb     Filled half notification.
+ * @param[in]  ctx    Application context.
+ * @return false if no DMA channel could be claimed.
+ */
+bool dma_stream_start(dma_stream_t *stream, enum dma_fifo_rx_port port,
+    uint8_t *buf, uint32_t len, dma_stream_cb_t cb, void const *ctx);
+
+/**
+ * @brief Start a continuous playback.
+ *
+ * Both halves must hold data; each is handed back through the callback
+ * once played.  I2S is switched to DMA_EN.
+ * @param[out] stream Stream state; must stay valid while running.
+ * @param[in]  port   DMA_FIFO_TX_I2S.
+ * @param[in]  buf    Playback buffer, word aligned.
+ * @param[in]  len    Buffer size in bytes; a multiple of 8.
+ * @param[in]  cb     Played half notification.
+ * @param[in]  ctx    Application context.
+ * @return false if no DMA channel could be claimed.
+ */
+bool dma_stream_play(dma_stream_t *stream, enum dma_fifo_tx_port port,
+    uint8_t *buf, uint32_t len, dma_stream_cb_t cb, void const *ctx);
+
+/**
+ * @brief Hand a half back to the stream.
+ * @param[in] stream Stream.
+ * @param[in] buf    Half received through the callback.
+ */
+void dma_stream_release(dma_stream_t *stream, uint8_t const *buf);
+
+/**
+ * @brief Stop after the half in progress (non blocking).
+ *
+ * That half is still reported through the callback.
+ * @param[in] stream Stream.
+ */
+void dma_stream_stop(dma_stream_t *stream);
+
+/**
+ * @brief Stop at once, releasing the channel before returning.
+ *
+ * The half in progress is dropped without a callback.  Unlike
+ * dma_stream_stop(), this does not depend on the port moving data.
+ * @param[in] stream Stream.
+ */
+void dma_stream_abort(dma_stream_t *stream);
+
+/**
+ * @brief Check whether a stream still owns its channel.
+ * @param[in] stream Stream.
+ * @return true until the stream has stopped.
+ */
+bool dma_stream_running(dma_stream_t const *stream);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} DMA_STREAM
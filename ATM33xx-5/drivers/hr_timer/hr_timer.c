@@ -0,0 +1,372 @@
+/**
+ *******************************************************************************
+ *
+ * @file hr_timer.c
+ *
+ * @brief High resolution timers on the dual timers
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#endif
+#include "arch.h"
+#include "timer.h"
+#include "hr_timer.h"
+
+#define HR_TIMER_SLOTS 2
+#define HR_TIMER_SLOT_NONE 0xff
+
+// Shortest dual timer load; closer deadlines fire as soon as possible
+#define HR_TIMER_MIN_CYCLES 1
+
+// Lag behind the dual timers ignored, covering load latency
+#define HR_TIMER_SYNC_SLACK 256
+
+static atm_timer_id_t const hr_timer_ids[HR_TIMER_SLOTS] = {
+    ATM_DUALTIMER1,
+    ATM_DUALTIMER2,
+};
+
+static CMSDK_DUALTIMER_SINGLE_TypeDef * const hr_timer_regs[HR_TIMER_SLOTS] = {
+    CMSDK_DUALTIMER1,
+    CMSDK_DUALTIMER2,
+};
+
+static struct {
+    hr_timer_t *head;
+    // Timer each dual timer counts toward
+    hr_timer_t *slot[HR_TIMER_SLOTS];
+    uint32_t pending;
+    // Cycles the core clock missed in sleep; added to DWT->CYCCNT
+    uint32_t skew;
+    bool ready;
+    hr_timer_stats_t stats;
+} hr_timer_q;
+
+/// Cycle count, moved up to what the armed dual timers have counted
+__FAST
+static uint32_t hr_timer_sync(void)
+{
+    for (uint8_t slot = 0; slot < HR_TIMER_SLOTS; slot++) {
+	hr_timer_t *timer = hr_timer_q.slot[slot];
+	if (!timer) {
+	    continue;
+	}
+	// VALUE first, so the estimate can only trail the cycle count
+	uint32_t counted = timer->deadline - hr_timer_regs[slot]->VALUE;
+	uint32_t behind = counted - (DWT->CYCCNT + hr_timer_q.skew);
+	if ((int32_t)behind > HR_TIMER_SYNC_SLACK) {
+	    hr_timer_q.skew += behind;
+	    hr_timer_q.stats.resyncs++;
+	}
+    }
+    return DWT->CYCCNT + hr_timer_q.skew;
+}
+
+__FAST
+uint32_t hr_timer_now(void)
+{
+    uint32_t now;
+
+    GLOBAL_INT_DISABLE();
+    now = hr_timer_sync();
+    GLOBAL_INT_RESTORE();
+    return now;
+}
+
+__FAST
+static void hr_timer_arm(uint8_t slot, hr_timer_t *timer, uint32_t now)
+{
+    uint32_t cycles = timer->deadline - now;
+
+    if ((int32_t)cycles < HR_TIMER_MIN_CYCLES) {
+	cycles = HR_TIMER_MIN_CYCLES;
+    }
+    hr_timer_q.slot[slot] = timer;
+    timer->slot = slot;
+    atm_dual_timer_single_shot_quick_start(hr_timer_ids[slot], cycles);
+}
+
+__FAST
+static void hr_timer_disarm(hr_timer_t *timer)
+{
+    if (timer->slot == HR_TIMER_SLOT_NONE) {
+	return;
+    }
+    atm_timer_stop(hr_timer_ids[timer->slot]);
+    hr_timer_q.slot[timer->slot] = NULL;
+    timer->slot = HR_TIMER_SLOT_NONE;
+}
+
+/// Keep the first two deadlines of the queue on the dual timers
+__FAST
+static void hr_timer_resync(void)
+{
+    hr_timer_t *head = hr_timer_q.head;
+    hr_timer_t *second = head ? head->next : NULL;
+
+    for (uint8_t slot = 0; slot < HR_TIMER_SLOTS; slot++) {
+	hr_timer_t *timer = hr_timer_q.slot[slot];
+	if (timer && (timer != head) && (timer != second)) {
+	    hr_timer_disarm(timer);
+	    hr_timer_q.stats.preempts++;
+	}
+    }
+
+    // Whatever is not armed now has a free dual timer
+    uint32_t now = hr_timer_sync();
+    if (head && (head->slot == HR_TIMER_SLOT_NONE)) {
+	hr_timer_arm(hr_timer_q.slot[0] ? 1 : 0, head, now);
+    }
+    if (second && (second->slot == HR_TIMER_SLOT_NONE)) {
+	hr_timer_arm(hr_timer_q.slot[0] ? 1 : 0, second, now);
+    }
+}
+
+__FAST
+static void hr_timer_unlink(hr_timer_t *timer)
+{
+    hr_timer_disarm(timer);
+    *timer->pprev = timer->next;
+    if (timer->next) {
+	timer->next->pprev = timer->pprev;
+    }
+    timer->pprev = NULL;
+    hr_timer_q.pending--;
+}
+
+/// File a timer after those with an earlier or equal deadline
+__FAST
+static void hr_timer_insert(hr_timer_t *timer, uint32_t now)
+{
+    uint32_t ahead = timer->deadline - now;
+    hr_timer_t **link = &hr_timer_q.head;
+
+    if ((int32_t)ahead < 0) {
+	// Late: due at once
+	ahead = 0;
+    }
+    while (*link) {
+	uint32_t other = (*link)->deadline - now;
+	if (((int32_t)other >= 0) && (other > ahead)) {
+	    break;
+	}
+	link = &(*link)->next;
+    }
+    timer->next = *link;
+    if (*link) {
+	(*link)->pprev = &timer->next;
+    }
+    *link = timer;
+    timer->pprev = link;
+
+    if (++hr_timer_q.pending > hr_timer_q.stats.max_pending) {
+	hr_timer_q.stats.max_pending = hr_timer_q.pending;
+    }
+}
+
+/// Next timer due at handler @p entry, with its latencies recorded
+__FAST
+static hr_timer_t *hr_timer_pop(uint32_t entry)
+{
+    hr_timer_t *timer = hr_timer_q.head;
+    uint32_t now = hr_timer_sync();
+
+    if (!timer || ((int32_t)(now - timer->deadline) < 0)) {
+	return NULL;
+    }
+    hr_timer_unlink(timer);
+
+    hr_timer_stats_t *stats = &hr_timer_q.stats;
+    uint32_t late = entry - timer->deadline;
+    if ((int32_t)late < 0) {
+	// Came due while draining an earlier one
+	late = 0;
+    }
+    uint32_t dispatch = (DWT->CYCCNT + hr_timer_q.skew) - entry;
+    stats->fired++;
+    stats->late_sum += late;
+    stats->dispatch_sum += dispatch;
+    if (late > stats->late_max) {
+	stats->late_max = late;
+    }
+    if (dispatch > stats->dispatch_max) {
+	stats->dispatch_max = dispatch;
+    }
+    return timer;
+}
+
+__FAST
+static void hr_timer_expired(uint8_t slot)
+{
+    uint32_t entry;
+    hr_timer_t *timer;
+
+    GLOBAL_INT_DISABLE();
+    // Catches up on cycles the core slept through
+    entry = hr_timer_sync();
+    timer = hr_timer_q.slot[slot];
+    // A stopped or displaced timer may still have left its interrupt
+    if (timer) {
+	hr_timer_q.slot[slot] = NULL;
+	timer->slot = HR_TIMER_SLOT_NONE;
+	if ((int32_t)(entry - timer->deadline) < 0) {
+	    hr_timer_q.stats.early++;
+	}
+    }
+    GLOBAL_INT_RESTORE();
+
+    for (;;) {
+	hr_timer_cb_t cb = NULL;
+	void const *ctx = NULL;
+
+	GLOBAL_INT_DISABLE();
+	timer = hr_timer_pop(entry);
+	if (timer) {
+	    cb = timer->cb;
+	    ctx = timer->ctx;
+	} else {
+	    hr_timer_resync();
+	}
+	GLOBAL_INT_RESTORE();
+	if (!timer) {
+	    break;
+	}
+	cb(timer, ctx);
+    }
+}
+
+__FAST
+static void hr_timer_expired1(void *app_context)
+{
+    hr_timer_expired(0);
+}
+
+__FAST
+static void hr_timer_expired2(void *app_context)
+{
+    hr_timer_expired(1);
+}
+
+void hr_timer_init(hr_timer_t *timer, hr_timer_cb_t cb, void const *ctx)
+{
+    *timer = (hr_timer_t) {
+	.cb = cb,
+	.ctx = ctx,
+	.slot = HR_TIMER_SLOT_NONE,
+    };
+}
+
+__FAST
+bool hr_timer_start_at(hr_timer_t *timer, uint32_t deadline)
+{
+    ASSERT_INFO(hr_timer_q.ready, timer, deadline);
+    if (!hr_timer_q.ready) {
+	return false;
+    }
+
+    GLOBAL_INT_DISABLE();
+    uint32_t now = hr_timer_sync();
+    ASSERT_INFO(((int32_t)(deadline - now) < (int32_t)HR_TIMER_MAX_CYCLES),
+	deadline, now);
+    if (timer->pprev) {
+	hr_timer_unlink(timer);
+    }
+    timer->deadline = deadline;
+    hr_timer_insert(timer, now);
+    hr_timer_resync();
+    GLOBAL_INT_RESTORE();
+    return true;
+}
+
+__FAST
+bool hr_timer_start(hr_timer_t *timer, uint32_t cycles)
+{
+    ASSERT_INFO(cycles <= HR_TIMER_MAX_CYCLES, cycles, HR_TIMER_MAX_CYCLES);
+    return hr_timer_start_at(timer, hr_timer_now() + cycles);
+}
+
+__FAST
+bool hr_timer_stop(hr_timer_t *timer)
+{
+    bool pending;
+
+    GLOBAL_INT_DISABLE();
+    pending = (timer->pprev != NULL);
+    if (pending) {
+	hr_timer_unlink(timer);
+	hr_timer_resync();
+    }
+    GLOBAL_INT_RESTORE();
+    return pending;
+}
+
+bool hr_timer_pending(hr_timer_t const *timer)
+{
+    return (timer->pprev != NULL);
+}
+
+bool hr_timer_is_active(uint32_t *min_freq)
+{
+    return (hr_timer_q.pending != 0);
+}
+
+/// Retention and hibernation stop the dual timers under pending deadlines
+static rep_vec_err_t hr_timer_prevent_sleep(bool *prevent, int32_t *pseq_dur,
+    int32_t ble_dur)
+{
+    if (!hr_timer_is_active(NULL)) {
+	return RV_NEXT;
+    }
+    *prevent = true;
+    return RV_DONE;
+}
+
+void hr_timer_stats_get(hr_timer_stats_t *stats, bool reset)
+{
+    GLOBAL_INT_DISABLE();
+    *stats = hr_timer_q.stats;
+    if (reset) {
+	hr_timer_q.stats = (hr_timer_stats_t) {
+	    .max_pending = hr_timer_q.pending,
+	};
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_HR_TIMER)
+#endif
+static void hr_timer_constructor(void)
+{
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    atm_timer_error_t err1 = atm_timer_setup(ATM_DUALTIMER1,
+	ATM_TIMER_MODE_SINGLE_SHOT, hr_timer_expired1);
+    atm_timer_error_t err2 = atm_timer_setup(ATM_DUALTIMER2,
+	ATM_TIMER_MODE_SINGLE_SHOT, hr_timer_expired2);
+    // Another owner of a dual timer would break both
+    ASSERT_INFO((err1 == ATM_TIMER_SUCCESS) && (err2 == ATM_TIMER_SUCCESS),
+	err1, err2);
+    hr_timer_q.ready = (err1 == ATM_TIMER_SUCCESS) &&
+	(err2 == ATM_TIMER_SUCCESS);
+    RV_PLF_PREVENT_RETENTION_ADD(hr_timer_prevent_sleep);
+    RV_PLF_PREVENT_HIBERNATION_ADD(hr_timer_prevent_sleep);
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int hr_timer_sys_init(void)
+{
+    hr_timer_constructor();
+    return hr_timer_q.ready ? 0 : -EBUSY;
+}
+
+SYS_INIT(hr_timer_sys_init, PRE_KERNEL_2, 5);
+#endif
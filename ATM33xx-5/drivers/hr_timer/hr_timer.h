@@ -0,0 +1,166 @@
+/**
+ *******************************************************************************
+ *
+ * @file hr_timer.h
+ *
+ * @brief High resolution timers on the dual timers
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup HR_TIMER High resolution timers
+ * @ingroup DRIVERS
+ * @brief Any number of cycle accurate one-shot deadlines on ATM_DUALTIMER1/2.
+ *
+ * Pending timers are kept in a queue sorted by deadline.  The two
+ * earliest are always armed, one per dual timer, with
+ * atm_dual_timer_single_shot_quick_start().  When one fires, the other is
+ * already counting toward the next deadline while the freed timer is
+ * loaded with the third.  A new deadline earlier than an armed one takes
+ * over that dual timer.
+ *
+ * Deadlines are in core clock cycles, on the cycle counter returned by
+ * hr_timer_now().  The dual timers are assumed to count the same clock.
+ * The core cycle counter stops while the core sleeps in WFI but the dual
+ * timers do not; whenever the driver reads the time it moves the counter
+ * up to what the armed dual timers have counted, so a pending deadline
+ * is never pushed back by sleep.  With no timer pending there is nothing
+ * to catch up from, and the counter falls behind over sleep: deadlines
+ * must be computed from a hr_timer_now() read after the last sleep, not
+ * from one kept across an idle period.  Retention and hibernation, which
+ * stop the dual timers, are held off while any timer is pending.
+ * The driver takes over ATM_DUALTIMER1 and ATM_DUALTIMER2; they must not
+ * be used through atm_timer_setup() elsewhere.  If either cannot be set
+ * up, the driver asserts and every start fails.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Longest delay in cycles; deadlines further out are ambiguous
+#define HR_TIMER_MAX_CYCLES (1UL << 30)
+
+struct hr_timer_s;
+
+/**
+ * @brief Expiry callback (called from interrupt context)
+ *
+ * The timer may be restarted from the callback.
+ * @param[in] timer Expired timer
+ * @param[in] ctx   Application context
+ */
+typedef void (*hr_timer_cb_t)(struct hr_timer_s *timer, void const *ctx);
+
+/// Timer
+typedef struct hr_timer_s {
+    /// @cond PRIVATE
+    struct hr_timer_s *next;
+    struct hr_timer_s **pprev;
+    uint32_t deadline;
+    hr_timer_cb_t cb;
+    void const *ctx;
+    uint8_t slot;
+    /// @endcond
+} hr_timer_t;
+
+/// Dispatch statistics
+typedef struct hr_timer_stats_s {
+    /// Timers expired
+    uint32_t fired;
+    /// Armed timers displaced from a dual timer by an earlier deadline
+    uint32_t preempts;
+    /// Stale dual timer interrupts taken before their deadline
+    uint32_t early;
+    /// Cycle counter catch-ups after the core clock stopped in sleep
+    uint32_t resyncs;
+    /// Most timers pending at once
+    uint32_t max_pending;
+    /// Worst deadline to interrupt handler entry in cycles
+    uint32_t late_max;
+    /// Worst handler entry to callback in cycles
+    uint32_t dispatch_max;
+    /// Sum of late cycles; divide by fired for the mean
+    uint64_t late_sum;
+    /// Sum of dispatch cycles; divide by fired for the mean
+    uint64_t dispatch_sum;
+} hr_timer_stats_t;
+
+/**
+ * @brief Prepare a timer.
+ * @param[out] timer Timer; must stay valid while pending.
+ * @param[in]  cb    Expiry callback.
+ * @param[in]  ctx   Application context.
+ */
+void hr_timer_init(hr_timer_t *timer, hr_timer_cb_t cb, void const *ctx);
+
+/**
+ * @brief Start or restart a timer at an absolute deadline.
+ *
+ * A deadline already passed expires at once.
+ * @param[in] timer    Timer.
+ * @param[in] deadline Cycle count to expire at, within HR_TIMER_MAX_CYCLES
+ * of hr_timer_now().
+ * @return false if the dual timers could not be claimed.
+ */
+bool hr_timer_start_at(hr_timer_t *timer, uint32_t deadline);
+
+/**
+ * @brief Start or restart a timer.
+ * @param[in] timer  Timer.
+ * @param[in] cycles Delay to the expiry in core clock cycles.
+ * @return false if the dual timers could not be claimed.
+ */
+bool hr_timer_start(hr_timer_t *timer, uint32_t cycles);
+
+/**
+ * @brief Stop a timer.
+ * @param[in] timer Timer.
+ * @return true if the timer was pending.
+ */
+bool hr_timer_stop(hr_timer_t *timer);
+
+/**
+ * @brief Check for a timer waiting to expire.
+ * @param[in] timer Timer.
+ * @return true from start until expiry or stop.
+ */
+bool hr_timer_pending(hr_timer_t const *timer);
+
+/**
+ * @brief Core clock cycle counter (wraps at 32 bits).
+ *
+ * Includes the cycles slept through while a timer was pending, as
+ * counted by the armed dual timers.
+ * @return Cycles.
+ */
+uint32_t hr_timer_now(void);
+
+/**
+ * @brief Fetch power management status
+ * @param[in,out] min_freq  Minimum frequency required by pending operations
+ * @return Avoid power saving modes when true
+ */
+bool hr_timer_is_active(uint32_t *min_freq);
+
+/**
+ * @brief Fetch dispatch statistics.
+ * @param[out] stats Statistics since boot or last reset.
+ * @param[in]  reset Clear the counters after reading.
+ */
+void hr_timer_stats_get(hr_timer_stats_t *stats, bool reset);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} HR_TIMER
@@ -0,0 +1,216 @@
+/**
+ *******************************************************************************
+ *
+ * @file i2s_dma.c
+ *
+ * @brief Full duplex I2S with circular DMA buffers
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#include <zephyr/irq.h>
+#endif
+#include "arch.h"
+#include "at_wrpr.h"
+#include "timer.h"
+#include "dma_stream.h"
+#include "i2s_dma.h"
+#include "at_i2s_regs_core_macro.h"
+
+#ifdef CONFIG_ATM_I2S_DMA_IRQ_PRI
+#define I2S_DMA_IRQ_PRI CONFIG_ATM_I2S_DMA_IRQ_PRI
+#else
+#define I2S_DMA_IRQ_PRI 2
+#endif
+
+// SRC_SNK_EN values
+#define I2S_SRC_EN 0x1
+#define I2S_SNK_EN 0x2
+// SRC_SNK: ping-pong buffers in memory 0
+#define I2S_SRC_SNK_AHB 1
+
+// Ping-pong set 0 (playback) underflows, set 1 (capture) overflows
+#define I2S_TX_UF_MASK (ATI2S_I2S_IRQ0__PP0_UF__MASK | \
+    ATI2S_I2S_IRQ0__PP1_UF__MASK | ATI2S_I2S_IRQ0__PP2_UF__MASK | \
+    ATI2S_I2S_IRQ0__PP3_UF__MASK)
+#define I2S_RX_OF_MASK (ATI2S_I2S_IRQ1__PP0_OF__MASK | \
+    ATI2S_I2S_IRQ1__PP1_OF__MASK | ATI2S_I2S_IRQ1__PP2_OF__MASK | \
+    ATI2S_I2S_IRQ1__PP3_OF__MASK)
+
+static i2s_dma_t *i2s_dma_cur;
+
+__FAST
+static void i2s_dma_half(dma_stream_t *stream, uint8_t *buf, uint32_t len,
+    bool second)
+{
+    i2s_dma_t *i2s = (i2s_dma_t *)stream->ctx;
+    bool tx = (stream == &i2s->tx);
+
+    i2s->since[tx][second] = atm_get_sys_time();
+    (tx ? i2s->cfg.tx_cb : i2s->cfg.rx_cb)(i2s, buf, len);
+}
+
+__FAST
+void i2s_dma_release(i2s_dma_t *i2s, uint8_t const *buf)
+{
+    bool tx = (buf >= i2s->cfg.tx_buf) &&
+	(buf < (i2s->cfg.tx_buf + i2s->cfg.tx_len));
+    dma_stream_t *stream = tx ? &i2s->tx : &i2s->rx;
+    uint32_t held = atm_get_sys_time() - i2s->since[tx][buf != stream->buf];
+
+    GLOBAL_INT_DISABLE();
+    if (held > i2s->stats.max_hold) {
+	i2s->stats.max_hold = held;
+    }
+    GLOBAL_INT_RESTORE();
+    dma_stream_release(stream, buf);
+}
+
+__FAST
+static void i2s_dma_handler(void)
+{
+    uint32_t irq0 = CMSDK_I2S->I2S_IRQ0 & I2S_TX_UF_MASK;
+    uint32_t irq1 = CMSDK_I2S->I2S_IRQ1 & I2S_RX_OF_MASK;
+
+    // Clear bits are not self clearing
+    CMSDK_I2S->I2S_IRQC0 = irq0;
+    CMSDK_I2S->I2S_IRQC0 = 0;
+    CMSDK_I2S->I2S_IRQC1 = irq1;
+    CMSDK_I2S->I2S_IRQC1 = 0;
+
+    i2s_dma_t *i2s = i2s_dma_cur;
+    if (!i2s) {
+	return;
+    }
+    if (irq0) {
+	i2s->stats.tx_underflows++;
+    }
+    if (irq1) {
+	i2s->stats.rx_overflows++;
+    }
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static void i2s_dma_isr(void const *arg)
+{
+    i2s_dma_handler();
+}
+#else
+void I2S_Handler(void)
+{
+    i2s_dma_handler();
+}
+#endif
+
+bool i2s_dma_start(i2s_dma_t *i2s, i2s_dma_cfg_t const *cfg)
+{
+    ASSERT_INFO(cfg->tx_buf || cfg->rx_buf, cfg->tx_buf, cfg->rx_buf);
+    ASSERT_INFO(!cfg->swap || (cfg->width == 16), cfg->swap, cfg->width);
+    ASSERT_INFO(!i2s_dma_cur, i2s_dma_cur, i2s);
+
+    *i2s = (i2s_dma_t) {
+	.cfg = *cfg,
+    };
+
+    WRPR_CTRL_SET(CMSDK_I2S, WRPR_CTRL__CLK_ENABLE);
+    CMSDK_I2S->I2S_CTRL1_TX =
+	ATI2S_I2S_CTRL1_TX__CK2SCK_RT__WRITE(cfg->ck2sck) |
+	ATI2S_I2S_CTRL1_TX__SCK2WS_RT__WRITE(cfg->sck2ws);
+    CMSDK_I2S->I2S_CTRL1_RX =
+	ATI2S_I2S_CTRL1_RX__CK2SCK_RT__WRITE(cfg->ck2sck) |
+	ATI2S_I2S_CTRL1_RX__SCK2WS_RT__WRITE(cfg->sck2ws);
+    ATI2S_I2S_CTRL2_TX__WSSD_MD__MODIFY(CMSDK_I2S->I2S_CTRL2_TX, cfg->fmt);
+    ATI2S_I2S_CTRL2_TX__SDW__MODIFY(CMSDK_I2S->I2S_CTRL2_TX, cfg->width);
+    ATI2S_I2S_CTRL2_RX__WSSD_MD__MODIFY(CMSDK_I2S->I2S_CTRL2_RX, cfg->fmt);
+    ATI2S_I2S_CTRL2_RX__SDW__MODIFY(CMSDK_I2S->I2S_CTRL2_RX, cfg->width);
+
+    // CTRL3 is playback, CTRL4 capture; no drift correction.  PCK_SMPL
+    // only packs 20/24-bit samples; 16-bit ones are paired regardless.
+    ATI2S_I2S_CTRL3__PCK_SMPL__CLR(CMSDK_I2S->I2S_CTRL3);
+    ATI2S_I2S_CTRL3__SWP_SMPL__MODIFY(CMSDK_I2S->I2S_CTRL3, cfg->swap);
+    ATI2S_I2S_CTRL3__INTRP_BYP__SET(CMSDK_I2S->I2S_CTRL3);
+    ATI2S_I2S_CTRL4__PCK_SMPL__CLR(CMSDK_I2S->I2S_CTRL4);
+    ATI2S_I2S_CTRL4__SWP_SMPL__MODIFY(CMSDK_I2S->I2S_CTRL4, cfg->swap);
+    ATI2S_I2S_CTRL4__INTRP_BYP__SET(CMSDK_I2S->I2S_CTRL4);
+
+    uint32_t ctrl0 = CMSDK_I2S->I2S_CTRL0;
+    ATI2S_I2S_CTRL0__SRC_SNK_EN__MODIFY(ctrl0, 0);
+    ATI2S_I2S_CTRL0__SRC_SNK__MODIFY(ctrl0, I2S_SRC_SNK_AHB);
+    ATI2S_I2S_CTRL0__MSTR_SCKWS_TX__MODIFY(ctrl0, cfg->master);
+    ATI2S_I2S_CTRL0__MSTR_SCKWS_RX__MODIFY(ctrl0, cfg->master);
+    ATI2S_I2S_CTRL0__WS_INIT_TX__MODIFY(ctrl0, cfg->fmt == I2S_DMA_FMT_PCM);
+    ATI2S_I2S_CTRL0__WS_INIT_RX__MODIFY(ctrl0, cfg->fmt == I2S_DMA_FMT_PCM);
+    CMSDK_I2S->I2S_CTRL0 = ctrl0;
+
+    // Capture first so no sample is lost once the block starts
+    if (cfg->rx_buf && !dma_stream_start(&i2s->rx, DMA_FIFO_RX_I2S,
+	cfg->rx_buf, cfg->rx_len, i2s_dma_half, i2s)) {
+	return false;
+    }
+    if (cfg->tx_buf && !dma_stream_play(&i2s->tx, DMA_FIFO_TX_I2S,
+	cfg->tx_buf, cfg->tx_len, i2s_dma_half, i2s)) {
+	if (cfg->rx_buf) {
+	    // SRC_SNK_EN is still clear; capture would never finish a half
+	    dma_stream_abort(&i2s->rx);
+	}
+	return false;
+    }
+
+    i2s_dma_cur = i2s;
+    CMSDK_I2S->I2S_IRQC0 = I2S_TX_UF_MASK;
+    CMSDK_I2S->I2S_IRQC0 = 0;
+    CMSDK_I2S->I2S_IRQC1 = I2S_RX_OF_MASK;
+    CMSDK_I2S->I2S_IRQC1 = 0;
+    CMSDK_I2S->I2S_IRQM0 = cfg->tx_buf ? I2S_TX_UF_MASK : 0;
+    CMSDK_I2S->I2S_IRQM1 = cfg->rx_buf ? I2S_RX_OF_MASK : 0;
+
+    // Playback starts on the first valid data, capture on the next WS
+    ATI2S_I2S_CTRL0__SRC_SNK_EN__MODIFY(CMSDK_I2S->I2S_CTRL0,
+	(cfg->tx_buf ? I2S_SRC_EN : 0) | (cfg->rx_buf ? I2S_SNK_EN : 0));
+    return true;
+}
+
+void i2s_dma_stop(i2s_dma_t *i2s)
+{
+    if (i2s->cfg.tx_buf) {
+	dma_stream_stop(&i2s->tx);
+    }
+    if (i2s->cfg.rx_buf) {
+	dma_stream_stop(&i2s->rx);
+    }
+    WFI_COND(!dma_stream_running(&i2s->tx) && !dma_stream_running(&i2s->rx));
+
+    CMSDK_I2S->I2S_IRQM0 = 0;
+    CMSDK_I2S->I2S_IRQM1 = 0;
+    ATI2S_I2S_CTRL0__SRC_SNK_EN__MODIFY(CMSDK_I2S->I2S_CTRL0, 0);
+    i2s_dma_cur = NULL;
+}
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_I2S_DMA)
+#endif
+static void i2s_dma_constructor(void)
+{
+#ifdef CONFIG_SOC_FAMILY_ATM
+    IRQ_CONNECT(I2S_IRQn, I2S_DMA_IRQ_PRI, i2s_dma_isr, NULL, 0);
+    irq_enable(I2S_IRQn);
+#else
+    NVIC_EnableIRQ(I2S_IRQn);
+#endif
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int i2s_dma_sys_init(void)
+{
+    i2s_dma_constructor();
+    return 0;
+}
+
+SYS_INIT(i2s_dma_sys_init, PRE_KERNEL_2, 3);
+#endif
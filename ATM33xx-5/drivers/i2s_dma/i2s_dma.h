@@ -0,0 +1,144 @@
+/**
+ *******************************************************************************
+ *
+ * @file i2s_dma.h
+ *
+ * @brief Full duplex I2S with circular DMA buffers
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup I2S_DMA I2S DMA audio
+ * @ingroup DRIVERS
+ * @brief Simultaneous playback and capture without per-sample interrupts.
+ *
+ * Each direction is a DMA stream (@see DMA_STREAM) over a buffer split in
+ * two halves; the DMA moves to the other half on its own and the
+ * application only has to return each half before it comes round again.
+ * 16-bit samples always share a ping-pong word two by two, halving the
+ * bus traffic of a stereo stream; wider samples take a word each.  The
+ * statistics tell how close the application comes to missing a half.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dma_stream.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Word select / serial data format
+enum i2s_dma_fmt {
+    I2S_DMA_FMT_PCM,
+    I2S_DMA_FMT_LEFT_JUSTIFIED,
+    I2S_DMA_FMT_RIGHT_JUSTIFIED,
+};
+
+struct i2s_dma_s;
+
+/**
+ * @brief Half notification (called from interrupt context)
+ *
+ * Capture: the half holds new samples.  Playback: the half has been
+ * played and can be refilled.  Either way, return it with
+ * i2s_dma_release().
+ * @param[in] i2s Driver state
+ * @param[in] buf Half
+ * @param[in] len Half size in bytes
+ */
+typedef void (*i2s_dma_cb_t)(struct i2s_dma_s *i2s, uint8_t *buf,
+    uint32_t len);
+
+/// Configuration
+typedef struct i2s_dma_cfg_s {
+    /// Drive SCK and WS (otherwise follow the codec)
+    bool master;
+    /// Data format
+    enum i2s_dma_fmt fmt;
+    /// Clocks per SCK period
+    uint16_t ck2sck;
+    /// SCK periods per WS period
+    uint16_t sck2ws;
+    /// Sample width in bits (1 to 32)
+    uint8_t width;
+    /// 16-bit only: first sample of a word in the upper half word
+    bool swap;
+    /// Playback buffer (word aligned, multiple of 8 bytes); NULL for none
+    uint8_t *tx_buf;
+    /// Playback buffer size in bytes
+    uint32_t tx_len;
+    /// Capture buffer (word aligned, multiple of 8 bytes); NULL for none
+    uint8_t *rx_buf;
+    /// Capture buffer size in bytes
+    uint32_t rx_len;
+    /// Played half notification
+    i2s_dma_cb_t tx_cb;
+    /// Captured half notification
+    i2s_dma_cb_t rx_cb;
+    /// Application context
+    void const *ctx;
+} i2s_dma_cfg_t;
+
+/// Statistics
+typedef struct i2s_dma_stats_s {
+    /// Playback ping-pong underflows reported by the I2S block
+    uint32_t tx_underflows;
+    /// Capture ping-pong overflows reported by the I2S block
+    uint32_t rx_overflows;
+    /// Longest time a half was held by the application (32 kHz ticks)
+    uint32_t max_hold;
+} i2s_dma_stats_t;
+
+/// Driver state
+typedef struct i2s_dma_s {
+    /// @cond PRIVATE
+    i2s_dma_cfg_t cfg;
+    uint32_t since[2][2];
+    /// @endcond
+    /// Playback stream; tx.stats.overruns counts halves returned late
+    dma_stream_t tx;
+    /// Capture stream; rx.stats.overruns counts halves returned late
+    dma_stream_t rx;
+    /// Statistics since i2s_dma_start()
+    i2s_dma_stats_t stats;
+} i2s_dma_t;
+
+/**
+ * @brief Configure the I2S block and start streaming.
+ *
+ * The playback buffer must hold data for both halves.  Pinmux and the
+ * codec are left to the caller.
+ * @param[out] i2s Driver state; must stay valid until closed.
+ * @param[in]  cfg Configuration, copied.
+ * @return false if the DMA channels could not be claimed.
+ */
+bool i2s_dma_start(i2s_dma_t *i2s, i2s_dma_cfg_t const *cfg);
+
+/**
+ * @brief Return a half received through a callback.
+ * @param[in] i2s Driver state.
+ * @param[in] buf Half.
+ */
+void i2s_dma_release(i2s_dma_t *i2s, uint8_t const *buf);
+
+/**
+ * @brief Stop both directions and disable the I2S block (blocking).
+ *
+ * The halves in progress complete and are reported first.
+ * @param[in] i2s Driver state.
+ */
+void i2s_dma_stop(i2s_dma_t *i2s);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} I2S_DMA
@@ -0,0 +1,173 @@
+/**
+ *******************************************************************************
+ *
+ * @file mono_time.c
+ *
+ * @brief Lock-free 64-bit monotonic time
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#endif
+#include "arch.h"
+#include "at_wrpr.h"
+#include "atm_bp_clock.h"
+#include "timer.h"
+#include "sw_timer.h"
+#include "mono_time.h"
+
+// Anchor: LPC tick tag above the low cycle count bits
+#define MONO_TIME_TAG_SHIFT 24
+#define MONO_TIME_CYC_MASK ((1UL << MONO_TIME_TAG_SHIFT) - 1)
+
+#define MONO_TIME_FRAC_ONE (1UL << MONO_TIME_FRAC_BITS)
+
+// Readers pick base[seq & 1]; the refresh writes the other copy first
+static struct {
+    uint32_t volatile seq;
+    uint64_t volatile base[2];
+} mono_time_latch;
+
+// Cycle count when the tick in the tag was first seen
+static uint32_t volatile mono_time_anchor;
+
+// 2^32 / cycles per LPC tick, valid at mono_time_freq
+static uint32_t volatile mono_time_mult;
+static uint32_t volatile mono_time_freq;
+
+static sw_timer_t mono_time_timer;
+
+__FAST
+static uint32_t mono_time_rt(void)
+{
+    uint32_t rt;
+    uint32_t rt1;
+
+    // Settled once two reads agree; an interrupt in between costs a retry
+    WRPR_CTRL_PUSH(CMSDK_PSEQ, WRPR_CTRL__CLK_ENABLE) {
+	rt = CMSDK_PSEQ->CURRENT_REAL_TIME;
+	do {
+	    rt1 = rt;
+	    rt = CMSDK_PSEQ->CURRENT_REAL_TIME;
+	} while (rt != rt1);
+    } WRPR_CTRL_POP();
+    return rt;
+}
+
+/// Widen a count read before or after the base snapshot
+__FAST
+static uint64_t mono_time_extend(uint32_t rt)
+{
+    uint32_t seq;
+    uint64_t base;
+
+    do {
+	seq = mono_time_latch.seq;
+	base = mono_time_latch.base[seq & 1];
+    } while (seq != mono_time_latch.seq);
+    return base + (int32_t)(rt - (uint32_t)base);
+}
+
+__FAST
+uint64_t mono_time_get(void)
+{
+    return mono_time_extend(mono_time_rt());
+}
+
+__FAST
+static uint32_t mono_time_cycle_mult(void)
+{
+    uint32_t freq = atm_bp_clock_get();
+
+    if (freq != mono_time_freq) {
+	uint32_t hz = atm_lpc_hz();
+	mono_time_mult = ((uint64_t)hz << 32) / freq;
+	mono_time_freq = freq;
+    }
+    return mono_time_mult;
+}
+
+__FAST
+uint64_t mono_time_get_fine(void)
+{
+    uint32_t rt;
+    uint32_t cyc;
+
+    // Pair a cycle count with the tick it was taken in
+    do {
+	rt = mono_time_rt();
+	cyc = DWT->CYCCNT;
+    } while (mono_time_rt() != rt);
+
+    uint32_t mult = mono_time_cycle_mult();
+    uint32_t tag = rt << MONO_TIME_TAG_SHIFT;
+    uint64_t frac;
+    for (;;) {
+	uint32_t anchor = __LDREXW(&mono_time_anchor);
+	frac = ((uint64_t)((cyc - anchor) & MONO_TIME_CYC_MASK) * mult) >>
+	    (32 - MONO_TIME_FRAC_BITS);
+	// A tag repeats every 256 ticks; the cycle count tells them apart
+	if (((anchor ^ tag) >> MONO_TIME_TAG_SHIFT) ||
+	    (frac >= (2 * MONO_TIME_FRAC_ONE))) {
+	    // First look at this tick: count from here
+	    if (__STREXW(tag | (cyc & MONO_TIME_CYC_MASK), &mono_time_anchor)) {
+		continue;
+	    }
+	    frac = 0;
+	    break;
+	}
+	__CLREX();
+	break;
+    }
+    if (frac >= MONO_TIME_FRAC_ONE) {
+	frac = MONO_TIME_FRAC_ONE - 1;
+    }
+    return (mono_time_extend(rt) << MONO_TIME_FRAC_BITS) | frac;
+}
+
+/// Sole writer of the base, from the slow timer interrupt
+__FAST
+static void mono_time_refresh(sw_timer_t *timer, void const *ctx)
+{
+    uint32_t seq = mono_time_latch.seq;
+    uint64_t now = mono_time_get();
+
+    // Each copy is written while readers are sent to the other one
+    mono_time_latch.base[(seq + 1) & 1] = now;
+    mono_time_latch.seq = seq + 1;
+    mono_time_latch.base[(seq + 2) & 1] = now;
+    mono_time_latch.seq = seq + 2;
+}
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_MONO_TIME)
+#endif
+static void mono_time_constructor(void)
+{
+    uint32_t rt = mono_time_rt();
+
+    mono_time_latch.base[0] = rt;
+    mono_time_latch.base[1] = rt;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+
+    // Well inside the 2^31 ticks mono_time_extend() can bridge
+    sw_timer_init(&mono_time_timer, mono_time_refresh, NULL);
+    sw_timer_start(&mono_time_timer, SW_TIMER_MAX_TICKS, SW_TIMER_MAX_TICKS);
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int mono_time_sys_init(void)
+{
+    mono_time_constructor();
+    return 0;
+}
+
+SYS_INIT(mono_time_sys_init, PRE_KERNEL_2, 4);
+#endif
@@ -0,0 +1,59 @@
+/**
+ *******************************************************************************
+ *
+ * @file mono_time.h
+ *
+ * @brief Lock-free 64-bit monotonic time
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup MONO_TIME Monotonic time
+ * @ingroup DRIVERS
+ * @brief atm_get_sys_time() widened to 64 bits, safe from any context.
+ *
+ * Reading never masks interrupts and never waits on another context.
+ * The 32-bit LPC count is widened against a base refreshed from the slow
+ * timer interrupt (@see SW_TIMER) long before the count wraps.  The base
+ * is double buffered, so a reader that interrupts the refresh uses the
+ * other copy instead of spinning.
+ *
+ * mono_time_get_fine() adds the fraction of the current LPC tick,
+ * measured with the core cycle counter from the first time the tick was
+ * seen by any reader.  The fraction is clamped to the tick, so fine
+ * times stay monotonic and in step with the coarse ones.
+ * @{
+ */
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Fraction bits of mono_time_get_fine()
+#define MONO_TIME_FRAC_BITS 16
+
+/**
+ * @brief LPC ticks since boot.
+ * @return Same count as atm_get_sys_time(), without the 32-bit wrap.
+ */
+uint64_t mono_time_get(void);
+
+/**
+ * @brief LPC ticks since boot with a sub-tick fraction.
+ * @return Ticks in 48.16 fixed point; shift right by MONO_TIME_FRAC_BITS
+ * for mono_time_get() units.
+ */
+uint64_t mono_time_get_fine(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} MONO_TIME
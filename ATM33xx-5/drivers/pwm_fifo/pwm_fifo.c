@@ -0,0 +1,291 @@
+/**
+ *******************************************************************************
+ *
+ * @file pwm_fifo.c
+ *
+ * @brief PWM FIFO streaming with DMA feed
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#include <zephyr/irq.h>
+#endif
+#include "arch.h"
+#include "at_wrpr.h"
+#include "dma.h"
+#include "pwm_fifo.h"
+#include "at_apb_pwm_regs_core_macro.h"
+
+#ifdef CONFIG_ATM_PWM_FIFO_IRQ_PRI
+#define PWM_FIFO_IRQ_PRI CONFIG_ATM_PWM_FIFO_IRQ_PRI
+#else
+#define PWM_FIFO_IRQ_PRI 2
+#endif
+
+// Channel MODE field
+#define PWM_MODE_IR_FIFO 3
+
+#define PWM_INTRPT_ALL (PWM_INTERRUPTS__FIFO_OVRFLOW_INTRPT__MASK | \
+    PWM_INTERRUPTS__FIFO_LWM_HIT_INTRPT__MASK | \
+    PWM_INTERRUPTS__FIFO_SEL_ERR_INTRPT__MASK | \
+    PWM_INTERRUPTS__FIFO_CMD_DONE_INTRPT__MASK)
+
+/// PWMn_CTRL, PWMn_DUR and PWMn_CFG repeat for each channel
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t DUR;
+    __IO uint32_t CFG;
+} pwm_chan_regs_t;
+
+#define PWM_CHAN_REGS(c) (((pwm_chan_regs_t *)&CMSDK_PWM->PWM0_CTRL) + (c))
+
+STATIC_ASSERT(offsetof(pwm_fifo_t, req) == 0, "pwm_fifo_rearm() cast");
+STATIC_ASSERT((offsetof(CMSDK_AT_APB_PWM_TypeDef, PWM7_CFG) -
+    offsetof(CMSDK_AT_APB_PWM_TypeDef, PWM0_CTRL)) ==
+    ((sizeof(pwm_chan_regs_t) * PWM_FIFO_CHAN_MAX) - sizeof(uint32_t)),
+    "PWM channel register layout");
+
+static pwm_fifo_t *pwm_fifo_owner;
+
+/// Interrupt clear bits are not self clearing
+__FAST
+static void pwm_fifo_irq_clear(uint32_t mask)
+{
+    CMSDK_PWM->INTERRUPTS_CLEAR = mask;
+    CMSDK_PWM->INTERRUPTS_CLEAR = 0;
+}
+
+static void pwm_fifo_flush(void)
+{
+    // Rising edge clears the FIFO
+    PWM_FIFO_CFG__FLUSH__SET(CMSDK_PWM->FIFO_CFG);
+    PWM_FIFO_CFG__FLUSH__CLR(CMSDK_PWM->FIFO_CFG);
+}
+
+__FAST
+static void pwm_fifo_finish(pwm_fifo_t *pwm, bool err)
+{
+    if (!pwm->running) {
+	return;
+    }
+    CMSDK_PWM->INTERRUPTS_MASK = 0;
+    pwm_fifo_irq_clear(PWM_INTRPT_ALL);
+    if (err) {
+	PWM_PWM0_CTRL__OK_TO_RUN__CLR(PWM_CHAN_REGS(pwm->cfg.chan)->CTRL);
+	pwm_fifo_flush();
+    }
+    dma_chan_release(pwm->req.chan);
+    pwm->running = false;
+    pwm_fifo_owner = NULL;
+    pwm->cfg.done(pwm, err);
+}
+
+/// The last entry is queued; let the channel stop once it has played
+__FAST
+static void pwm_fifo_last(pwm_fifo_t *pwm)
+{
+    pwm->feeding = false;
+    PWM_FIFO_CFG__CH_STOP__SET(CMSDK_PWM->FIFO_CFG);
+    if (PWM_FIFO_STAT__EMPTY__READ(CMSDK_PWM->FIFO_STAT)) {
+	// The low watermark hit came (as an underrun) before this
+	pwm_fifo_finish(pwm, false);
+    }
+}
+
+/// Load the next buffer from the application into the request
+__FAST
+static bool pwm_fifo_next(pwm_fifo_t *pwm)
+{
+    uint16_t const *buf;
+    uint32_t count;
+
+    if (pwm->stop || !pwm->cfg.refill || !pwm->cfg.refill(pwm, &buf, &count) ||
+	!count) {
+	return false;
+    }
+    pwm->req.src = (uint32_t)buf;
+    pwm->req.size = count * sizeof(uint16_t);
+    return true;
+}
+
+__FAST
+static bool pwm_fifo_rearm(dma_req_t *req)
+{
+    pwm_fifo_t *pwm = (pwm_fifo_t *)req;
+
+    pwm->stats.entries += req->size / sizeof(uint16_t);
+    return pwm_fifo_next(pwm);
+}
+
+__FAST
+static void pwm_fifo_dma_done(dma_req_t *req, bool err)
+{
+    pwm_fifo_t *pwm = (pwm_fifo_t *)req;
+
+    if (err) {
+	pwm->stats.errors++;
+	pwm_fifo_finish(pwm, true);
+	return;
+    }
+    pwm->stats.entries += req->size / sizeof(uint16_t);
+    pwm_fifo_last(pwm);
+}
+
+__FAST
+static void pwm_fifo_handler(void)
+{
+    uint32_t irq = CMSDK_PWM->INTERRUPTS & CMSDK_PWM->INTERRUPTS_MASK;
+    pwm_fifo_t *pwm = pwm_fifo_owner;
+
+    pwm_fifo_irq_clear(irq);
+    if (!pwm) {
+	return;
+    }
+    if (irq & (PWM_INTERRUPTS__FIFO_OVRFLOW_INTRPT__MASK |
+	PWM_INTERRUPTS__FIFO_SEL_ERR_INTRPT__MASK)) {
+	pwm->stats.errors++;
+    }
+    if (irq & PWM_INTERRUPTS__FIFO_LWM_HIT_INTRPT__MASK) {
+	if (pwm->feeding) {
+	    // The last entry repeats until DMA catches up
+	    pwm->stats.underruns++;
+	} else {
+	    pwm_fifo_finish(pwm, false);
+	}
+    }
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static void pwm_fifo_isr(void const *arg)
+{
+    pwm_fifo_handler();
+}
+#else
+void PWM_Handler(void)
+{
+    pwm_fifo_handler();
+}
+#endif
+
+bool pwm_fifo_start(pwm_fifo_t *pwm, pwm_fifo_cfg_t const *cfg,
+    uint16_t const *buf, uint32_t count)
+{
+    ASSERT_INFO(cfg->chan < PWM_FIFO_CHAN_MAX, cfg->chan, count);
+    ASSERT_INFO(count && cfg->done && !((uint32_t)buf & 0x1), buf, count);
+
+    bool busy;
+    GLOBAL_INT_DISABLE();
+    busy = (pwm_fifo_owner != NULL);
+    if (!busy) {
+	pwm_fifo_owner = pwm;
+    }
+    GLOBAL_INT_RESTORE();
+    if (busy) {
+	return false;
+    }
+
+    // A refilled sequence must not have others queued behind it
+    int chan = dma_chan_claim(DMA_PRIO_HIGH);
+    if (chan < 0) {
+	pwm_fifo_owner = NULL;
+	return false;
+    }
+
+    *pwm = (pwm_fifo_t) {
+	.req = {
+	    .src_type = DMA_TYPE_MEM,
+	    .fifo_width = sizeof(uint16_t),
+	    .chan = chan,
+	    .cb = pwm_fifo_dma_done,
+	    .rearm = pwm_fifo_rearm,
+	},
+	.cfg = *cfg,
+	.running = true,
+    };
+    dma_fifo_tx_req(DMA_FIFO_TX_PWM, &pwm->req);
+
+    WRPR_CTRL_SET(CMSDK_PWM, WRPR_CTRL__CLK_ENABLE);
+    pwm_chan_regs_t *regs = PWM_CHAN_REGS(cfg->chan);
+    PWM_PWM0_CTRL__OK_TO_RUN__CLR(regs->CTRL);
+    PWM_PWM0_CTRL__MODE__MODIFY(regs->CTRL, PWM_MODE_IR_FIFO);
+    PWM_PWM0_CTRL__INVERT__MODIFY(regs->CTRL, cfg->invert);
+    PWM_PWM0_CTRL__IDLE_POLARITY__MODIFY(regs->CTRL, cfg->idle_high);
+    CMSDK_PWM->FIFO_CARRIER1_DUR =
+	PWM_FIFO_CARRIER1_DUR__HI_DUR__WRITE(cfg->carrier[0].hi_dur) |
+	PWM_FIFO_CARRIER1_DUR__LO_DUR__WRITE(cfg->carrier[0].lo_dur);
+    CMSDK_PWM->FIFO_CARRIER2_DUR =
+	PWM_FIFO_CARRIER2_DUR__HI_DUR__WRITE(cfg->carrier[1].hi_dur) |
+	PWM_FIFO_CARRIER2_DUR__LO_DUR__WRITE(cfg->carrier[1].lo_dur);
+
+    // Hit when the FIFO runs dry; the last entry repeats until CH_STOP
+    pwm_fifo_flush();
+    PWM_FIFO_CFG__LWM__MODIFY(CMSDK_PWM->FIFO_CFG, PWM_FIFO_DEPTH);
+    PWM_FIFO_CFG__CH_STOP__CLR(CMSDK_PWM->FIFO_CFG);
+
+    // Prime the FIFO so the channel has something to start with
+    uint32_t prime = (count < PWM_FIFO_DEPTH) ? count : PWM_FIFO_DEPTH;
+    for (uint32_t i = 0; i < prime; i++) {
+	CMSDK_PWM->FIFO_DATA = buf[i];
+    }
+    pwm->stats.entries = prime;
+
+    pwm_fifo_irq_clear(PWM_INTRPT_ALL);
+    CMSDK_PWM->INTERRUPTS_MASK = PWM_INTERRUPTS_MASK__MASK_INTRPT0__MASK |
+	PWM_INTERRUPTS_MASK__MASK_INTRPT1__MASK |
+	PWM_INTERRUPTS_MASK__MASK_INTRPT2__MASK;
+
+    GLOBAL_INT_DISABLE();
+    pwm->feeding = true;
+    if (prime < count) {
+	pwm->req.src = (uint32_t)(buf + prime);
+	pwm->req.size = (count - prime) * sizeof(uint16_t);
+	dma_submit(&pwm->req);
+    } else if (pwm_fifo_next(pwm)) {
+	dma_submit(&pwm->req);
+    } else {
+	pwm->feeding = false;
+	PWM_FIFO_CFG__CH_STOP__SET(CMSDK_PWM->FIFO_CFG);
+    }
+    PWM_PWM0_CTRL__OK_TO_RUN__SET(regs->CTRL);
+    GLOBAL_INT_RESTORE();
+    return true;
+}
+
+void pwm_fifo_stop(pwm_fifo_t *pwm)
+{
+    pwm->stop = true;
+}
+
+bool pwm_fifo_running(pwm_fifo_t const *pwm)
+{
+    return pwm->running;
+}
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_PWM_FIFO)
+#endif
+static void pwm_fifo_constructor(void)
+{
+#ifdef CONFIG_SOC_FAMILY_ATM
+    IRQ_CONNECT(PWM_IRQn, PWM_FIFO_IRQ_PRI, pwm_fifo_isr, NULL, 0);
+    irq_enable(PWM_IRQn);
+#else
+    NVIC_EnableIRQ(PWM_IRQn);
+#endif
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int pwm_fifo_sys_init(void)
+{
+    pwm_fifo_constructor();
+    return 0;
+}
+
+SYS_INIT(pwm_fifo_sys_init, PRE_KERNEL_2, 3);
+#endif
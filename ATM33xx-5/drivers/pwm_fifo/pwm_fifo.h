@@ -0,0 +1,159 @@
+/**
+ *******************************************************************************
+ *
+ * @file pwm_fifo.h
+ *
+ * @brief PWM FIFO streaming with DMA feed
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup PWM_FIFO PWM FIFO streaming
+ * @ingroup DRIVERS
+ * @brief IR_FIFO_MODE sequences played from memory.
+ *
+ * The PWM block has a single 16 entry FIFO, which one channel (any of
+ * PWM0..7) consumes in IR_FIFO_MODE.  Each entry plays frame_count + 1
+ * periods of one of two carriers, either as a mark (carrier output) or a
+ * space (output low).  The first entries are written by the CPU, the rest
+ * by DMA paced on the FIFO open slots.  Longer sequences are fed buffer
+ * by buffer through a refill callback, called from the DMA interrupt
+ * while the FIFO still holds up to 16 entries.  The FIFO low watermark
+ * interrupt catches the FIFO running dry: at the end of the sequence
+ * (completion) or while DMA is still feeding (underrun).
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Number of PWM channels
+#define PWM_FIFO_CHAN_MAX 8
+/// FIFO depth in entries
+#define PWM_FIFO_DEPTH 16
+/// Largest number of periods in one entry
+#define PWM_FIFO_FRAMES_MAX 0x4000
+
+/// FIFO entry: frames periods of carrier (0 or 1) output
+#define PWM_FIFO_MARK(carrier, frames) \
+    ((uint16_t)(((carrier) << 15) | (1 << 14) | (((frames) - 1) & 0x3fff)))
+/// FIFO entry: output low for frames periods of carrier (0 or 1)
+#define PWM_FIFO_SPACE(carrier, frames) \
+    ((uint16_t)(((carrier) << 15) | (((frames) - 1) & 0x3fff)))
+
+struct pwm_fifo;
+
+/**
+ * @brief Supply the next buffer (called from interrupt context)
+ * @param[in]  pwm   Stream
+ * @param[out] buf   Next entries; must stay valid until played
+ * @param[out] count Number of entries
+ * @return false to end the sequence after the current buffer
+ */
+typedef bool (*pwm_fifo_refill_t)(struct pwm_fifo *pwm, uint16_t const **buf,
+    uint32_t *count);
+
+/**
+ * @brief Sequence finished (called from interrupt context)
+ *
+ * Called once the FIFO is empty; the last entry is still playing and the
+ * channel stops by itself after it.
+ * @param[in] pwm Stream
+ * @param[in] err true if DMA failed and the sequence was cut short
+ */
+typedef void (*pwm_fifo_done_t)(struct pwm_fifo *pwm, bool err);
+
+/// Carrier period in clk_mpc cycles
+typedef struct pwm_fifo_carrier_s {
+    /// High portion
+    uint16_t hi_dur;
+    /// Low portion
+    uint16_t lo_dur;
+} pwm_fifo_carrier_t;
+
+/// Stream configuration
+typedef struct pwm_fifo_cfg_s {
+    /// PWM channel (0 to 7)
+    uint8_t chan;
+    /// Invert the output
+    bool invert;
+    /// Output level while idle
+    bool idle_high;
+    /// Carriers selected by bit 15 of the entries
+    pwm_fifo_carrier_t carrier[2];
+    /// Next buffer; NULL for a single buffer sequence
+    pwm_fifo_refill_t refill;
+    /// Completion
+    pwm_fifo_done_t done;
+    /// Application context
+    void const *ctx;
+} pwm_fifo_cfg_t;
+
+/// Stream statistics
+typedef struct pwm_fifo_stats_s {
+    /// Entries written to the FIFO
+    uint32_t entries;
+    /// Times the FIFO ran dry while DMA was still feeding
+    uint32_t underruns;
+    /// DMA errors and FIFO overflows
+    uint32_t errors;
+} pwm_fifo_stats_t;
+
+/// Stream state
+typedef struct pwm_fifo {
+    /// @cond PRIVATE
+    dma_req_t req;
+    pwm_fifo_cfg_t cfg;
+    bool feeding;
+    bool stop;
+    bool running;
+    /// @endcond
+    /// Statistics since pwm_fifo_start()
+    pwm_fifo_stats_t stats;
+} pwm_fifo_t;
+
+/**
+ * @brief Start playing a sequence.
+ *
+ * The channel is switched to IR_FIFO_MODE and started; pinmux is left
+ * to the caller.  Only one stream can own the FIFO at a time.
+ * @param[out] pwm   Stream state; must stay valid while running.
+ * @param[in]  cfg   Configuration, copied.
+ * @param[in]  buf   First entries; must stay valid until played.
+ * @param[in]  count Number of entries.
+ * @return false if the FIFO or a DMA channel is taken.
+ */
+bool pwm_fifo_start(pwm_fifo_t *pwm, pwm_fifo_cfg_t const *cfg,
+    uint16_t const *buf, uint32_t count);
+
+/**
+ * @brief End the sequence after the current buffer (non blocking).
+ *
+ * Entries already queued are still played and done() is called.
+ * @param[in] pwm Stream.
+ */
+void pwm_fifo_stop(pwm_fifo_t *pwm);
+
+/**
+ * @brief Check whether a stream still owns the FIFO.
+ * @param[in] pwm Stream.
+ * @return true until done() has been called.
+ */
+bool pwm_fifo_running(pwm_fifo_t const *pwm);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} PWM_FIFO
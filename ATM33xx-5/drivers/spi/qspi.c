@@ -0,0 +1,164 @@
+/**
+ *******************************************************************************
+ *
+ * @file qspi.c
+ *
+ * @brief QSPI bulk bit-bang transfers
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#include "arch.h"
+#include "qspi.h"
+#include "spi_flash.h"
+
+#define QSPI_NIBBLE_SETUP(__n) \
+    (((0x2222 | ((__n) & 0x1) | (((__n) & 0x2) << 3) | \
+    (((__n) & 0x4) << 6) | (((__n) & 0x8) << 9))) \
+    << QSPI_TRANSACTION_SETUP__DOUT_0_CTRL__SHIFT)
+
+// TRANSACTION_SETUP per nibble; not const so it stays out of flash
+static uint32_t qspi_nibble_setup[16] = {
+    QSPI_NIBBLE_SETUP(0x0), QSPI_NIBBLE_SETUP(0x1),
+    QSPI_NIBBLE_SETUP(0x2), QSPI_NIBBLE_SETUP(0x3),
+    QSPI_NIBBLE_SETUP(0x4), QSPI_NIBBLE_SETUP(0x5),
+    QSPI_NIBBLE_SETUP(0x6), QSPI_NIBBLE_SETUP(0x7),
+    QSPI_NIBBLE_SETUP(0x8), QSPI_NIBBLE_SETUP(0x9),
+    QSPI_NIBBLE_SETUP(0xa), QSPI_NIBBLE_SETUP(0xb),
+    QSPI_NIBBLE_SETUP(0xc), QSPI_NIBBLE_SETUP(0xd),
+    QSPI_NIBBLE_SETUP(0xe), QSPI_NIBBLE_SETUP(0xf),
+};
+
+__FAST
+void qspi_drive_buf(uint8_t const *buf, uint32_t len)
+{
+    volatile uint32_t *setup = &CMSDK_QSPI->TRANSACTION_SETUP;
+
+    for (; len; len--) {
+	uint8_t byte = *buf++;
+	uint32_t hi = qspi_nibble_setup[byte >> 4];
+	uint32_t lo = qspi_nibble_setup[byte & 0xf];
+
+	*setup = hi;
+	*setup = hi | QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
+	*setup = lo;
+	*setup = lo | QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
+    }
+}
+
+__FAST
+void qspi_capture_buf(uint8_t *buf, uint32_t len)
+{
+    volatile uint32_t *setup = &CMSDK_QSPI->TRANSACTION_SETUP;
+
+    for (; len; len--) {
+	*setup = 0;
+	*setup = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
+	*setup = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK |
+	    QSPI_TRANSACTION_SETUP__SAMPLE_DIN__WRITE(0xf0);
+	*setup = 0;
+	*setup = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
+	*setup = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK |
+	    QSPI_TRANSACTION_SETUP__SAMPLE_DIN__WRITE(0x0f);
+	*buf++ = CMSDK_QSPI->READ_DATA;
+    }
+}
+
+// DOUT_0/DOUT_1 driven with the two low bits of __d
+#define QSPI_DUAL_SETUP(__d) \
+    ((0x22 | ((__d) & 0x1) | (((__d) & 0x2) << 3)) \
+    << QSPI_TRANSACTION_SETUP__DOUT_0_CTRL__SHIFT)
+
+__FAST
+static void qspi_drive_dual_byte(uint8_t byte)
+{
+    for (int shift = 6; shift >= 0; shift -= 2) {
+	uint32_t oe = QSPI_DUAL_SETUP(byte >> shift);
+	CMSDK_QSPI->TRANSACTION_SETUP = oe;
+	CMSDK_QSPI->TRANSACTION_SETUP = oe |
+	    QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
+    }
+}
+
+__FAST
+static void qspi_capture_dual_buf(uint8_t *buf, uint32_t len)
+{
+    volatile uint32_t *setup = &CMSDK_QSPI->TRANSACTION_SETUP;
+
+    for (; len; len--) {
+	uint8_t byte = 0;
+	for (int i = 0; i < 4; i++) {
+	    *setup = 0;
+	    *setup = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
+	    *setup = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK |
+		QSPI_TRANSACTION_SETUP__SAMPLE_DIN__WRITE(0x03);
+	    byte = (byte << 2) | (CMSDK_QSPI->READ_DATA & 0x3);
+	}
+	*buf++ = byte;
+    }
+}
+
+__FAST
+void qspi_read(uint32_t addr, uint8_t *buf, uint32_t len,
+    spi_flash_read_mode_t mode, uint8_t dummy)
+{
+    // Not const so it stays out of flash
+    static uint8_t opcode[] = {
+	[SPI_FLASH_MODE_111] = SPI_FLASH_FREAD,
+	[SPI_FLASH_MODE_112] = SPI_FLASH_DREAD,
+	[SPI_FLASH_MODE_122] = SPI_FLASH_2READ,
+	[SPI_FLASH_MODE_114] = SPI_FLASH_QREAD,
+	[SPI_FLASH_MODE_144] = SPI_FLASH_4READ,
+    };
+    ASSERT_INFO(mode <= SPI_FLASH_MODE_144, mode, addr);
+
+    qspi_drive_start();
+    qspi_drive_serial_cmd(opcode[mode]);
+
+    switch (mode) {
+    case SPI_FLASH_MODE_122:
+	qspi_drive_dual_byte(addr >> 16);
+	qspi_drive_dual_byte(addr >> 8);
+	qspi_drive_dual_byte(addr);
+	// Mode bits of all ones keep the flash out of continuous read
+	for (; dummy; dummy--) {
+	    CMSDK_QSPI->TRANSACTION_SETUP = QSPI_DUAL_SETUP(0x3);
+	    CMSDK_QSPI->TRANSACTION_SETUP = QSPI_DUAL_SETUP(0x3) |
+		QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
+	}
+	break;
+    case SPI_FLASH_MODE_144:
+	qspi_drive_byte(addr >> 16);
+	qspi_drive_byte(addr >> 8);
+	qspi_drive_byte(addr);
+	for (; dummy; dummy--) {
+	    qspi_drive_nibble(0xf);
+	}
+	break;
+    default:
+	qspi_drive_serial_cmd(addr >> 16);
+	qspi_drive_serial_cmd(addr >> 8);
+	qspi_drive_serial_cmd(addr);
+	qspi_dummy(dummy);
+	break;
+    }
+
+    switch (mode) {
+    case SPI_FLASH_MODE_111:
+	for (; len; len--) {
+	    *buf++ = qspi_read_serial_byte();
+	}
+	break;
+    case SPI_FLASH_MODE_112:
+    case SPI_FLASH_MODE_122:
+	qspi_capture_dual_buf(buf, len);
+	break;
+    default:
+	qspi_capture_buf(buf, len);
+	break;
+    }
+
+    qspi_drive_stop();
+}
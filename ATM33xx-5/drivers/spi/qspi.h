@@ -23,6 +23,7 @@
 #include <stdint.h>
 
 #include "at_apb_qspi_regs_core_macro.h"
+#include "spi_flash.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -52,14 +53,22 @@ static inline void
 #endif
 qspi_drive_serial_cmd(uint8_t cmd)
 {
-    for (int i=0; i<8; i++, cmd<<=1) {
-	uint32_t oe = ((cmd & 0x80) ? 0x0003 : 0x0002)
-	    << QSPI_TRANSACTION_SETUP__DOUT_0_CTRL__SHIFT;
+#define QSPI_SERIAL_BIT(__b) do { \
+    uint32_t oe = (0x0002 | ((cmd >> (__b)) & 0x1)) \
+	<< QSPI_TRANSACTION_SETUP__DOUT_0_CTRL__SHIFT; \
+    CMSDK_QSPI->TRANSACTION_SETUP = oe; \
+    CMSDK_QSPI->TRANSACTION_SETUP = oe | QSPI_TRANSACTION_SETUP__CLK_VAL__MASK; \
+} while (0)
 
-	CMSDK_QSPI->TRANSACTION_SETUP = oe;
-	CMSDK_QSPI->TRANSACTION_SETUP = oe |
-	    QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
-    }
+    QSPI_SERIAL_BIT(7);
+    QSPI_SERIAL_BIT(6);
+    QSPI_SERIAL_BIT(5);
+    QSPI_SERIAL_BIT(4);
+    QSPI_SERIAL_BIT(3);
+    QSPI_SERIAL_BIT(2);
+    QSPI_SERIAL_BIT(1);
+    QSPI_SERIAL_BIT(0);
+#undef QSPI_SERIAL_BIT
 }
 
 /**
@@ -71,16 +80,24 @@ __INLINE uint8_t
 qspi_read_serial_byte(void)
 {
     uint8_t data = 0;
-    for (uint8_t i = 0x80; i; i >>= 1) {
-	CMSDK_QSPI->TRANSACTION_SETUP = 0;
-	CMSDK_QSPI->TRANSACTION_SETUP = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK;
-	CMSDK_QSPI->TRANSACTION_SETUP = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK |
-	    QSPI_TRANSACTION_SETUP__SAMPLE_DIN__WRITE(0x02);
 
-	if (CMSDK_QSPI->READ_DATA & 0x02) {
-	    data |= i;
-	}
-    }
+#define QSPI_SERIAL_SAMPLE(__b) do { \
+    CMSDK_QSPI->TRANSACTION_SETUP = 0; \
+    CMSDK_QSPI->TRANSACTION_SETUP = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK; \
+    CMSDK_QSPI->TRANSACTION_SETUP = QSPI_TRANSACTION_SETUP__CLK_VAL__MASK | \
+	QSPI_TRANSACTION_SETUP__SAMPLE_DIN__WRITE(0x02); \
+    data |= ((CMSDK_QSPI->READ_DATA >> 1) & 0x1) << (__b); \
+} while (0)
+
+    QSPI_SERIAL_SAMPLE(7);
+    QSPI_SERIAL_SAMPLE(6);
+    QSPI_SERIAL_SAMPLE(5);
+    QSPI_SERIAL_SAMPLE(4);
+    QSPI_SERIAL_SAMPLE(3);
+    QSPI_SERIAL_SAMPLE(2);
+    QSPI_SERIAL_SAMPLE(1);
+    QSPI_SERIAL_SAMPLE(0);
+#undef QSPI_SERIAL_SAMPLE
     return (data);
 }
 #endif
@@ -92,40 +109,15 @@ qspi_read_serial_byte(void)
  */
 #ifndef __GNUC__
 __INLINE uint32_t
-to_oe_format_quad(uint8_t nibble)
-{
-    if (nibble > 0xf) {
-	return 0;
-    }
-    return (0x2222 | (nibble & 0x1) | ((nibble & 0x2) << 3) |
-	((nibble & 0x4) << 6) | ((nibble & 0x8) << 9));
-}
 #else
 static inline uint32_t
+#endif
 to_oe_format_quad(uint8_t nibble)
 {
-    switch (nibble) {
-	case 0x0: return 0x2222;
-	case 0x1: return 0x2223;
-	case 0x2: return 0x2232;
-	case 0x3: return 0x2233;
-	case 0x4: return 0x2322;
-	case 0x5: return 0x2323;
-	case 0x6: return 0x2332;
-	case 0x7: return 0x2333;
-	case 0x8: return 0x3222;
-	case 0x9: return 0x3223;
-	case 0xa: return 0x3232;
-	case 0xb: return 0x3233;
-	case 0xc: return 0x3322;
-	case 0xd: return 0x3323;
-	case 0xe: return 0x3332;
-	case 0xf: return 0x3333;
-	default: break;
-    }
-    return 0;
+    // Each DOUT_n_CTRL is {oe=1, val=bit n}
+    return (0x2222 | (nibble & 0x1) | ((nibble & 0x2) << 3) |
+	((nibble & 0x4) << 6) | ((nibble & 0x8) << 9));
 }
-#endif
 
 /**
  * @brief Drive all QSPI outputs for a single cycle
@@ -197,6 +189,56 @@ qspi_capture_byte(void)
 	QSPI_TRANSACTION_SETUP__SAMPLE_DIN__WRITE(0x0f);
 }
 
+/**
+ * @brief Drive all QSPI outputs for eight cycles, most significant first
+ * @param[in] word 32-bit value to drive
+ */
+#ifndef __GNUC__
+__INLINE void
+#else
+static inline void
+#endif
+qspi_drive_word(uint32_t word)
+{
+    qspi_drive_byte(word >> 24);
+    qspi_drive_byte(word >> 16);
+    qspi_drive_byte(word >> 8);
+    qspi_drive_byte(word);
+}
+
+/**
+ * @brief Drive a buffer on all QSPI outputs, two cycles per byte
+ * @note Located in RAM; usable while external flash is unavailable.
+ * @param[in] buf Data to drive
+ * @param[in] len Number of bytes
+ */
+void qspi_drive_buf(uint8_t const *buf, uint32_t len);
+
+/**
+ * @brief Capture a buffer from all QSPI inputs, two cycles per byte
+ * @note Located in RAM; usable while external flash is unavailable.
+ * @param[out] buf Captured data
+ * @param[in] len Number of bytes
+ */
+void qspi_capture_buf(uint8_t *buf, uint32_t len);
+
+/**
+ * @brief Read external flash over the bit-banged QSPI bus
+ *
+ * Issues the standard read opcode for the protocol.  For 1-2-2 and 1-4-4
+ * the dummy cycles are driven high, which also supplies non-continuous
+ * mode bits; for the other protocols they are left undriven.
+ * @note Located in RAM; usable while external flash is unavailable.
+ * @param[in] addr 3-byte flash address
+ * @param[out] buf Destination buffer
+ * @param[in] len Number of bytes
+ * @param[in] mode Read protocol
+ * @param[in] dummy Cycles between address and data, mode cycles included
+ * (see spi_flash_sfdp_t::read_dummy)
+ */
+void qspi_read(uint32_t addr, uint8_t *buf, uint32_t len,
+    spi_flash_read_mode_t mode, uint8_t dummy);
+
 /**
  * @brief End QSPI transaction
  */
@@ -0,0 +1,143 @@
+/**
+ *******************************************************************************
+ *
+ * @file qspi_xip.c
+ *
+ * @brief QSPI execute-in-place (remote AHB) configuration
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#include "arch.h"
+#include "at_wrpr.h"
+#include "qspi.h"
+#include "qspi_xip.h"
+
+// Continuous read is left by clocking a non-matching mode byte
+#define QSPI_XIP_EXIT_PERFORMANCE_MODE 0xff
+
+static bool qspi_xip_performance_mode;
+
+__FAST
+static void qspi_xip_barrier(void)
+{
+    __DSB();
+    __ISB();
+}
+
+__FAST
+void qspi_xip_cache_invalidate(void)
+{
+    QSPI_REMOTE_AHB_SETUP__INVALIDATE_ENTIRE_CACHE__SET(
+	CMSDK_QSPI->REMOTE_AHB_SETUP);
+    QSPI_REMOTE_AHB_SETUP__INVALIDATE_ENTIRE_CACHE__CLR(
+	CMSDK_QSPI->REMOTE_AHB_SETUP);
+    qspi_xip_barrier();
+}
+
+__FAST
+void qspi_xip_cache_enable(bool enable)
+{
+    if (enable) {
+	qspi_xip_cache_invalidate();
+	QSPI_REMOTE_AHB_SETUP__ENABLE_CACHE__SET(CMSDK_QSPI->REMOTE_AHB_SETUP);
+    } else {
+	QSPI_REMOTE_AHB_SETUP__ENABLE_CACHE__CLR(CMSDK_QSPI->REMOTE_AHB_SETUP);
+    }
+    qspi_xip_barrier();
+}
+
+__FAST
+void qspi_xip_suspend(void)
+{
+    qspi_xip_barrier();
+    qspi_drive_stop();
+
+    if (qspi_xip_performance_mode) {
+	// Mode byte is sampled on all four lines during the address phase
+	qspi_drive_start();
+	for (int i = 0; i < 8; i++) {
+	    qspi_drive_nibble(QSPI_XIP_EXIT_PERFORMANCE_MODE & 0xf);
+	}
+	qspi_drive_stop();
+    }
+}
+
+__FAST
+void qspi_xip_resume(void)
+{
+    CMSDK_QSPI->TRANSACTION_SETUP =
+	QSPI_TRANSACTION_SETUP__CSN_VAL__MASK |
+	QSPI_TRANSACTION_SETUP__REMOTE_AHB_QSPI_HAS_CONTROL__MASK;
+    qspi_xip_cache_invalidate();
+}
+
+__FAST
+void qspi_xip_configure(qspi_xip_cfg_t const *cfg)
+{
+    ASSERT_INFO(cfg->dummy_cycles <=
+	(QSPI_REMOTE_AHB_SETUP__DUMMY_CYCLES__MASK >>
+	QSPI_REMOTE_AHB_SETUP__DUMMY_CYCLES__SHIFT), cfg->dummy_cycles,
+	cfg->opcode);
+
+    WRPR_CTRL_SET(CMSDK_QSPI, WRPR_CTRL__CLK_ENABLE);
+    // Handlers in external flash must not run while the bus is taken
+    GLOBAL_INT_DISABLE();
+    qspi_xip_suspend();
+
+    uint32_t setup = CMSDK_QSPI->REMOTE_AHB_SETUP &
+	~(QSPI_REMOTE_AHB_SETUP__DUMMY_CYCLES__MASK |
+	QSPI_REMOTE_AHB_SETUP__MODE__MASK |
+	QSPI_REMOTE_AHB_SETUP__OPCODE__MASK |
+	QSPI_REMOTE_AHB_SETUP__CLKDIVSEL__MASK |
+	QSPI_REMOTE_AHB_SETUP__QUAD_OVERHEAD__MASK |
+	QSPI_REMOTE_AHB_SETUP__ENABLE_CACHE__MASK);
+    setup |= QSPI_REMOTE_AHB_SETUP__DUMMY_CYCLES__WRITE(cfg->dummy_cycles) |
+	QSPI_REMOTE_AHB_SETUP__MODE__WRITE(cfg->width) |
+	QSPI_REMOTE_AHB_SETUP__IS_OPCODE__MASK |
+	QSPI_REMOTE_AHB_SETUP__OPCODE__WRITE(cfg->opcode) |
+	QSPI_REMOTE_AHB_SETUP__CLKDIVSEL__WRITE(cfg->clkdivsel) |
+	QSPI_REMOTE_AHB_SETUP__QUAD_OVERHEAD__WRITE(cfg->quad_overhead) |
+	QSPI_REMOTE_AHB_SETUP__ENABLE_CLOCKS__MASK |
+	QSPI_REMOTE_AHB_SETUP__ENABLE_CACHE__WRITE(cfg->cache);
+    CMSDK_QSPI->REMOTE_AHB_SETUP = setup;
+
+    uint32_t setup_3 = CMSDK_QSPI->REMOTE_AHB_SETUP_3;
+    QSPI_REMOTE_AHB_SETUP_3__OPCODE_PERFORMANCE_MODE__MODIFY(setup_3,
+	cfg->performance_opcode);
+    QSPI_REMOTE_AHB_SETUP_3__ENABLE_PERFORMANCE_MODE__MODIFY(setup_3,
+	cfg->performance_mode);
+    CMSDK_QSPI->REMOTE_AHB_SETUP_3 = setup_3;
+    qspi_xip_performance_mode = cfg->performance_mode;
+
+    QSPI_MODE__IS_QUAD__MODIFY(CMSDK_QSPI->MODE,
+	cfg->width == QSPI_XIP_QUAD);
+    QSPI_MODE__IS_DUAL__MODIFY(CMSDK_QSPI->MODE,
+	cfg->width == QSPI_XIP_DUAL);
+
+    qspi_xip_resume();
+    GLOBAL_INT_RESTORE();
+}
+
+__FAST
+void qspi_xip_remap_set(qspi_xip_remap_t const *remap)
+{
+    CMSDK_QSPI->REMOTE_AHB_SETUP_7 =
+	QSPI_REMOTE_AHB_SETUP_7__REMAP_TABLE__WRITE(remap->table) |
+	QSPI_REMOTE_AHB_SETUP_7__REMAP_MSB_LOC_SUB2__WRITE(
+	    remap->msb_loc_sub2) |
+	QSPI_REMOTE_AHB_SETUP_7__REMAP_LEGACY__WRITE(remap->legacy);
+    qspi_xip_cache_invalidate();
+}
+
+void qspi_xip_remap_get(qspi_xip_remap_t *remap)
+{
+    uint32_t setup_7 = CMSDK_QSPI->REMOTE_AHB_SETUP_7;
+
+    remap->table = QSPI_REMOTE_AHB_SETUP_7__REMAP_TABLE__READ(setup_7);
+    remap->msb_loc_sub2 =
+	QSPI_REMOTE_AHB_SETUP_7__REMAP_MSB_LOC_SUB2__READ(setup_7);
+    remap->legacy = QSPI_REMOTE_AHB_SETUP_7__REMAP_LEGACY__READ(setup_7);
+}
@@ -0,0 +1,124 @@
+/**
+ *******************************************************************************
+ *
+ * @file qspi_xip.h
+ *
+ * @brief QSPI execute-in-place (remote AHB) configuration
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup QSPI_XIP QSPI execute-in-place
+ * @ingroup QSPI
+ * @brief Configure the QSPI remote AHB path used to execute from external
+ * flash, and manage its read cache and address remap table.
+ *
+ * Every function here runs from RAM: the flash is unreachable while the
+ * controller is being reconfigured.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Remote AHB read bus width (REMOTE_AHB_SETUP.MODE encoding)
+typedef enum {
+    QSPI_XIP_SINGLE = 0,
+    QSPI_XIP_DUAL = 1,
+    QSPI_XIP_QUAD = 2,
+} qspi_xip_width_t;
+
+/// Remote AHB read configuration
+typedef struct {
+    /// Read opcode (e.g. 0xeb for 1-4-4)
+    uint8_t opcode;
+    /// Dummy cycles between address and data
+    uint8_t dummy_cycles;
+    /// Read bus width
+    qspi_xip_width_t width;
+    /// QSPI clock divider select: 0=1x 1=2x 2=4x 3=8x
+    uint8_t clkdivsel;
+    /// Opcode sent serially plus two mode cycles (Macronix, GigaDevice,
+    /// Winbond); false when the opcode is sent in quad (Micron)
+    bool quad_overhead;
+    /// Continuous read: skip the opcode after the first access
+    bool performance_mode;
+    /// Mode byte that keeps the flash in continuous read
+    uint8_t performance_opcode;
+    /// Enable the read cache
+    bool cache;
+} qspi_xip_cfg_t;
+
+/// Remote AHB address remap (REMOTE_AHB_SETUP_7 fields)
+typedef struct {
+    /// REMAP_TABLE
+    uint32_t table;
+    /// REMAP_MSB_LOC_SUB2: most significant remapped address bit, minus 2
+    uint8_t msb_loc_sub2;
+    /// REMAP_LEGACY: use the fixed legacy mapping instead of table
+    bool legacy;
+} qspi_xip_remap_t;
+
+/**
+ * @brief Apply a read configuration and hand the bus to the remote AHB.
+ *
+ * The flash must already have QE set when a quad width is selected.
+ * The cache is invalidated.  Interrupts are masked while the bus is taken.
+ * @param[in] cfg Read configuration.
+ */
+void qspi_xip_configure(qspi_xip_cfg_t const *cfg);
+
+/**
+ * @brief Discard all cached flash contents.
+ */
+void qspi_xip_cache_invalidate(void);
+
+/**
+ * @brief Enable or disable the read cache.
+ * @param[in] enable Cache state.
+ */
+void qspi_xip_cache_enable(bool enable);
+
+/**
+ * @brief Take the bus from the remote AHB for direct flash access.
+ *
+ * Leaves continuous read mode so the flash accepts new commands.  Code and
+ * data in external flash must not be touched until qspi_xip_resume(), so
+ * the caller must run from RAM with interrupts masked (GLOBAL_INT_DISABLE)
+ * across the pair.
+ */
+void qspi_xip_suspend(void);
+
+/**
+ * @brief Return the bus to the remote AHB after direct flash access.
+ *
+ * Invalidates the cache since the flash contents may have changed.
+ */
+void qspi_xip_resume(void);
+
+/**
+ * @brief Program the address remap table.
+ * @param[in] remap Remap configuration.
+ */
+void qspi_xip_remap_set(qspi_xip_remap_t const *remap);
+
+/**
+ * @brief Read back the address remap table.
+ * @param[out] remap Remap configuration.
+ */
+void qspi_xip_remap_get(qspi_xip_remap_t *remap);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} QSPI_XIP
@@ -22,6 +22,18 @@
 #include "at_wrpr.h"
 #include "at_apb_pseq_regs_core_macro.h"
 #include "atm_bp_clock.h"
+#ifdef CFG_SPI_CACHE
+#include "spi_cache.h"
+#endif
+#ifdef CFG_SPI_ASYNC
+#include "spi_async.h"
+// Keep the transaction queue off the bus around synchronous accesses
+#define SPI_SYNC_BEGIN(__spi) spi_async_lock(__spi)
+#define SPI_SYNC_END(__spi) spi_async_unlock(__spi)
+#else
+#define SPI_SYNC_BEGIN(__spi) do {} while (0)
+#define SPI_SYNC_END(__spi) do {} while (0)
+#endif
 
 #if defined(CFG_ROM) || defined(CFG_USER)
 const
@@ -97,13 +109,32 @@ spi_write_4(const spi_dev_t *spi, uint8_t opcode, uint32_t data)
 }
 
 uint32_t
-spi_pmuradio_read_word(const spi_dev_t *spi, uint8_t block, uint8_t addr)
+spi_pmuradio_read_word_nocache(const spi_dev_t *spi, uint8_t block,
+			       uint8_t addr)
 {
     uint8_t opcode = block << 4;
 
+    SPI_SYNC_BEGIN(spi);
     do_spi_transaction(spi, 0, opcode, 5, 0x0, addr);
-    return ((spi->base->DATA_BYTES_UPPER << 24) |
-	    (spi->base->DATA_BYTES_LOWER >> 8));
+    uint32_t data = (spi->base->DATA_BYTES_UPPER << 24) |
+	(spi->base->DATA_BYTES_LOWER >> 8);
+    SPI_SYNC_END(spi);
+#ifdef CFG_SPI_CACHE
+    spi_cache_update(spi, block, addr, data);
+#endif
+    return data;
+}
+
+uint32_t
+spi_pmuradio_read_word(const spi_dev_t *spi, uint8_t block, uint8_t addr)
+{
+#ifdef CFG_SPI_CACHE
+    uint32_t data;
+    if (spi_cache_lookup(spi, block, addr, &data)) {
+	return data;
+    }
+#endif
+    return spi_pmuradio_read_word_nocache(spi, block, addr);
 }
 
 void
@@ -114,7 +145,65 @@ spi_pmuradio_write_word(const spi_dev_t *spi, uint8_t block, uint8_t addr,
     uint32_t lower = (data << 8) | addr;
     uint32_t upper = data >> 24;
 
+    SPI_SYNC_BEGIN(spi);
     do_spi_transaction(spi, 0, opcode, 5, upper, lower);
+    SPI_SYNC_END(spi);
+#ifdef CFG_SPI_CACHE
+    spi_cache_update(spi, block, addr, data);
+#endif
+}
+
+uint16_t
+spi_pmuradio_write_batch(const spi_dev_t *spi, spi_pmuradio_reg_t const *regs,
+			 uint16_t num, bool verify)
+{
+    CMSDK_AT_APB_SPI_TypeDef *base = spi->base;
+    uint32_t setup = spi_transaction_setup(spi, 0, 0, 5);
+
+    // Short 5-byte transactions: spin rather than take an interrupt each.
+    SPI_SYNC_BEGIN(spi);
+    for (uint16_t i = 0; i < num; i++) {
+	uint8_t opcode = (regs[i].block << 4) | 0x1;
+	uint32_t transaction = setup |
+	    SPI_TRANSACTION_SETUP__OPCODE__WRITE(opcode);
+
+	base->DATA_BYTES_LOWER = (regs[i].value << 8) | regs[i].addr;
+	base->DATA_BYTES_UPPER = regs[i].value >> 24;
+	base->TRANSACTION_SETUP = transaction;
+	base->TRANSACTION_SETUP = transaction |
+	    SPI_TRANSACTION_SETUP__START__MASK;
+	while (base->TRANSACTION_STATUS &
+	    SPI_TRANSACTION_STATUS__RUNNING__MASK) {
+	    YIELD();
+	}
+#ifdef CFG_SPI_CACHE
+	spi_cache_update(spi, regs[i].block, regs[i].addr, regs[i].value);
+#endif
+    }
+    SPI_SYNC_END(spi);
+
+    if (!verify) {
+	return 0;
+    }
+
+    uint16_t mismatches = 0;
+    uint16_t first = 0;
+    uint32_t first_read = 0;
+    for (uint16_t i = 0; i < num; i++) {
+	uint32_t read_back = spi_pmuradio_read_word_nocache(spi, regs[i].block,
+	    regs[i].addr);
+	if (read_back != regs[i].value) {
+	    if (!mismatches++) {
+		first = i;
+		first_read = read_back;
+	    }
+	}
+    }
+    DEBUG_TRACE_COND(mismatches, "SPI batch: %u/%u mismatch, first [%u] "
+	"blk %u addr 0x%02x wrote 0x%08lx read 0x%08lx", mismatches, num,
+	first, regs[first].block, regs[first].addr,
+	(unsigned long)regs[first].value, (unsigned long)first_read);
+    return mismatches;
 }
 
 #ifdef SPI_TRANS_WFI
@@ -148,12 +237,20 @@ void SPI2_Handler(void)
 
 void SPI_RADIO_Handler(void)
 {
+#ifdef CFG_SPI_ASYNC
+    spi_async_handler(&spi_radio);
+#else
     spi_interrupt_handler(CMSDK_RADIO);
+#endif
 }
 
 void SPI_PMU_Handler(void)
 {
+#ifdef CFG_SPI_ASYNC
+    spi_async_handler(&spi_pmu);
+#else
     spi_interrupt_handler(CMSDK_PMU);
+#endif
 }
 
 #ifdef PSEQ_CTRL0__SPI_LATCH_OPEN__CLR
@@ -56,6 +56,31 @@ const
 #endif
 spi_dev_t spi_radio;
 
+/**
+ * @brief Compose TRANSACTION_SETUP for a transaction (START not set).
+ * @param[in] spi            Device structure.
+ * @param[in] csn_stays_low  State of select at end of transaction.
+ * @param[in] opcode         First byte written to bus by master.
+ * @param[in] num_data_bytes Total bytes in transaction.
+ * @return Value for TRANSACTION_SETUP register.
+ */
+#ifdef CFG_ROM
+static inline
+#else
+__INLINE
+#endif
+uint32_t
+spi_transaction_setup(const spi_dev_t *spi, bool csn_stays_low,
+    uint8_t opcode, uint8_t num_data_bytes)
+{
+    return (SPI_TRANSACTION_SETUP__DUMMY_CYCLES__WRITE(spi->dummy_cycles) |
+	SPI_TRANSACTION_SETUP__CSN_STAYS_LOW__WRITE(csn_stays_low) |
+	SPI_TRANSACTION_SETUP__OPCODE__WRITE(opcode) |
+	SPI_TRANSACTION_SETUP__CLKDIV__WRITE(spi->clkdiv) |
+	SPI_TRANSACTION_SETUP__RWB__MASK |
+	SPI_TRANSACTION_SETUP__NUM_DATA_BYTES__WRITE(num_data_bytes));
+}
+
 /**
  * @brief Base function for all SPI transactions.
  * @param[in] spi            Device structure.
@@ -74,13 +99,8 @@ void
 do_spi_transaction(const spi_dev_t *spi, bool csn_stays_low,
     uint8_t opcode, uint8_t num_data_bytes, uint32_t upper, uint32_t lower)
 {
-    uint32_t transaction =
-	SPI_TRANSACTION_SETUP__DUMMY_CYCLES__WRITE(spi->dummy_cycles) |
-	SPI_TRANSACTION_SETUP__CSN_STAYS_LOW__WRITE(csn_stays_low) |
-	SPI_TRANSACTION_SETUP__OPCODE__WRITE(opcode) |
-	SPI_TRANSACTION_SETUP__CLKDIV__WRITE(spi->clkdiv) |
-	SPI_TRANSACTION_SETUP__RWB__MASK |
-	SPI_TRANSACTION_SETUP__NUM_DATA_BYTES__WRITE(num_data_bytes);
+    uint32_t transaction = spi_transaction_setup(spi, csn_stays_low, opcode,
+	num_data_bytes);
 
     spi->base->DATA_BYTES_LOWER = lower;
     spi->base->DATA_BYTES_UPPER = upper;
@@ -195,6 +215,16 @@ void spi_write_4(const spi_dev_t *spi, uint8_t opcode, uint32_t data);
  */
 uint32_t spi_pmuradio_read_word(const spi_dev_t *spi, uint8_t block, uint8_t addr);
 
+/**
+ * @brief Read PMU or RADIO module register, bypassing the shadow cache.
+ * @param[in] spi   Device structure.
+ * @param[in] block Single byte module block to read.
+ * @param[in] addr  Single byte address of data to read.
+ * @return Data read from PMU or RADIO module.
+ */
+uint32_t spi_pmuradio_read_word_nocache(const spi_dev_t *spi, uint8_t block,
+    uint8_t addr);
+
 /**
  * @brief Write PMU or RADIO module register.
  * @param[in] spi   Device structure.
@@ -204,16 +234,52 @@ uint32_t spi_pmuradio_read_word(const spi_dev_t *spi, uint8_t block, uint8_t add
  */
 void spi_pmuradio_write_word(const spi_dev_t *spi, uint8_t block, uint8_t addr, uint32_t data);
 
+/// PMU or RADIO module register write descriptor
+typedef struct spi_pmuradio_reg_s {
+    /// Module block
+    uint8_t block;
+    /// Register address within block
+    uint8_t addr;
+    /// Value to write
+    uint32_t value;
+} spi_pmuradio_reg_t;
+
+/**
+ * @brief Write a table of PMU or RADIO module registers.
+ *
+ * Registers are written back-to-back in table order.  When verify is set, all
+ * registers are read back in a second pass once every write has been issued,
+ * and mismatches are reported once for the whole table.
+ * @param[in] spi    Device structure.
+ * @param[in] regs   Register table.
+ * @param[in] num    Number of entries in regs.
+ * @param[in] verify Read back and compare after writing.
+ * @return Number of registers whose read-back value did not match.
+ */
+uint16_t spi_pmuradio_write_batch(const spi_dev_t *spi,
+    spi_pmuradio_reg_t const *regs, uint16_t num, bool verify);
+
 #ifndef VERIFY_SPI_CAL
 #define VERIFY_SPI_CAL PLF_DEBUG
 #endif
 
+/// Register table entry for spi_pmuradio_write_batch()
+#define SPR_BATCH_ENTRY(__m, __reg, __val) \
+    { __m ## __REG_BLADDR, __m ## __ ## __reg, (__val) }
+
+#define SPR_WRITE_BATCH(__d, __regs) do { \
+    __UNUSED uint16_t mismatches = spi_pmuradio_write_batch(__d, __regs, \
+	sizeof(__regs) / sizeof((__regs)[0]), VERIFY_SPI_CAL); \
+    ASSERT_INFO(!mismatches, mismatches, sizeof(__regs) / sizeof((__regs)[0])); \
+} while (0)
+
 #define SPR_READ(__d, __m, __reg) \
     spi_pmuradio_read_word(__d, __m ## __REG_BLADDR, __m ## __ ##  __reg)
 
 #if VERIFY_SPI_CAL
 #define SPR_VERIFY(__d, __m, __reg, __val) do { \
-    uint32_t read_back = SPR_READ(__d, __m, __reg); \
+    uint32_t read_back = spi_pmuradio_read_word_nocache(__d, \
+	__m ## __REG_BLADDR, __m ## __ ## __reg); \
     ASSERT_INFO((__val) == read_back, (__val), read_back); \
 } while (0)
 #else
@@ -237,6 +303,10 @@ void spi_pmuradio_write_word(const spi_dev_t *spi, uint8_t block, uint8_t addr,
 #define SWREG_WRITE(__m, __reg, __val) \
     SPR_WRITE(&spi_pmu, SWREG_ ## __m, __reg, __val)
 
+#define PMU_BATCH_ENTRY(__m, __reg, __val) \
+    SPR_BATCH_ENTRY(PMU_ ## __m, __reg, __val)
+#define PMU_WRITE_BATCH(__regs) SPR_WRITE_BATCH(&spi_pmu, __regs)
+
 #define PMU_GADC_READ(__reg) PMU_READ(GADC, __reg)
 #define PMU_GADC_WRITE(__reg, __val) PMU_WRITE(GADC, __reg, __val)
 
@@ -255,6 +325,10 @@ void spi_pmuradio_write_word(const spi_dev_t *spi, uint8_t block, uint8_t addr,
 #define RADIO_WRITE(__m, __reg, __val) \
     SPR_WRITE(&spi_radio, RADIO_ ## __m, __reg, __val)
 
+#define RADIO_BATCH_ENTRY(__m, __reg, __val) \
+    SPR_BATCH_ENTRY(RADIO_ ## __m, __reg, __val)
+#define RADIO_WRITE_BATCH(__regs) SPR_WRITE_BATCH(&spi_radio, __regs)
+
 #define RADIO_RX_READ(__reg) RADIO_READ(RX, __reg)
 #define RADIO_RX_WRITE(__reg, __val) RADIO_WRITE(RX, __reg, __val)
 
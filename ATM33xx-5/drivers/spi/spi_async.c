@@ -0,0 +1,282 @@
+/**
+ *******************************************************************************
+ *
+ * @file spi_async.c
+ *
+ * @brief Interrupt driven PMU/RADIO SPI transaction queue
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#include <zephyr/irq.h>
+#endif
+
+#include "arch.h"
+#include "spi.h"
+#include "spi_async.h"
+#ifdef CFG_SPI_CACHE
+#include "spi_cache.h"
+#endif
+
+typedef struct {
+    spi_dev_t const *spi;
+    spi_async_batch_t *head;
+    spi_async_batch_t *tail;
+    // Synchronous accessors holding the device (spi_async_lock)
+    uint8_t held;
+    // A queued transfer is on the bus
+    bool active;
+} spi_async_queue_t;
+
+static spi_async_queue_t spi_async_pmu = { .spi = &spi_pmu };
+static spi_async_queue_t spi_async_radio = { .spi = &spi_radio };
+
+static spi_async_queue_t *spi_async_queue(spi_dev_t const *spi)
+{
+    if (spi == &spi_pmu) {
+	return &spi_async_pmu;
+    }
+    ASSERT_INFO(spi == &spi_radio, spi, spi->base);
+    return &spi_async_radio;
+}
+
+/**
+ * @brief Launch the current transfer of the head batch.
+ *
+ * Same framing as spi_pmuradio_{read,write}_word().
+ */
+__FAST
+static void spi_async_start(spi_async_queue_t *q)
+{
+    spi_dev_t const *spi = q->spi;
+    spi_async_xfer_t const *xfer = &q->head->xfers[q->head->pos];
+    uint8_t opcode = xfer->block << 4;
+    uint32_t lower = xfer->addr;
+    uint32_t upper = 0;
+
+    if (xfer->write) {
+	opcode |= 0x1;
+	lower |= xfer->data << 8;
+	upper = xfer->data >> 24;
+    }
+
+    q->active = true;
+    uint32_t transaction = spi_transaction_setup(spi, false, opcode, 5);
+    spi->base->INTERRUPT_MASK = SPI_INTERRUPT_MASK__WRITE;
+    spi->base->DATA_BYTES_LOWER = lower;
+    spi->base->DATA_BYTES_UPPER = upper;
+    spi->base->TRANSACTION_SETUP = transaction;
+    spi->base->TRANSACTION_SETUP = transaction |
+	SPI_TRANSACTION_SETUP__START__MASK;
+}
+
+/// Start the next queued transfer unless a synchronous accessor holds the bus
+__FAST
+static void spi_async_kick(spi_async_queue_t *q)
+{
+    if (q->head && !q->held) {
+	spi_async_start(q);
+    } else {
+	q->spi->base->INTERRUPT_MASK = 0;
+    }
+}
+
+__FAST
+void spi_async_handler(spi_dev_t const *spi)
+{
+    spi_async_queue_t *q = spi_async_queue(spi);
+    CMSDK_AT_APB_SPI_TypeDef *base = spi->base;
+
+    uint32_t status = base->INTERRUPT_STATUS;
+    base->RESET_INTERRUPT = status;
+    base->RESET_INTERRUPT = 0;
+
+    // A synchronous transaction may have raised the interrupt
+    if (!q->active || (base->TRANSACTION_STATUS &
+	SPI_TRANSACTION_STATUS__RUNNING__MASK)) {
+	return;
+    }
+    q->active = false;
+
+    spi_async_batch_t *batch = q->head;
+    spi_async_xfer_t *xfer = &batch->xfers[batch->pos];
+    if (!xfer->write) {
+	xfer->data = (base->DATA_BYTES_UPPER << 24) |
+	    (base->DATA_BYTES_LOWER >> 8);
+    }
+#ifdef CFG_SPI_CACHE
+    spi_cache_update(spi, xfer->block, xfer->addr, xfer->data);
+#endif
+
+    if (++batch->pos < batch->num_xfers) {
+	spi_async_kick(q);
+	return;
+    }
+
+    // Batch complete; move on before the callback so it may resubmit.
+    q->head = batch->next;
+    if (!q->head) {
+	q->tail = NULL;
+    }
+    spi_async_kick(q);
+
+    if (batch->cb) {
+	batch->cb(batch, batch->ctx);
+    }
+}
+
+/// Complete the transfer on the bus without relying on the interrupt
+__FAST
+static void spi_async_poll(spi_async_queue_t *q)
+{
+    GLOBAL_INT_DISABLE();
+    if (q->active && !(q->spi->base->TRANSACTION_STATUS &
+	SPI_TRANSACTION_STATUS__RUNNING__MASK)) {
+	spi_async_handler(q->spi);
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+void spi_async_submit(spi_dev_t const *spi, spi_async_batch_t *batch)
+{
+    ASSERT_INFO(batch->num_xfers, batch, batch->xfers);
+    spi_async_queue_t *q = spi_async_queue(spi);
+
+    batch->next = NULL;
+    batch->pos = 0;
+
+    GLOBAL_INT_DISABLE();
+    if (q->tail) {
+	q->tail->next = batch;
+	q->tail = batch;
+    } else {
+	q->head = q->tail = batch;
+    }
+    if (!q->active) {
+	spi->base->RESET_INTERRUPT = SPI_RESET_INTERRUPT__WRITE;
+	spi->base->RESET_INTERRUPT = 0;
+	spi_async_kick(q);
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+bool spi_async_busy(spi_dev_t const *spi)
+{
+    return (spi_async_queue(spi)->head != NULL);
+}
+
+void spi_async_flush(spi_dev_t const *spi)
+{
+    spi_async_queue_t *q = spi_async_queue(spi);
+    IPSR_Type psr = {.w = __get_IPSR()};
+
+    ASSERT_INFO(!q->held, q->held, q->head);
+    if (psr.b.ISR || __get_PRIMASK() || __get_BASEPRI()) {
+	// Cannot wait for our own interrupt; run the queue by polling
+	while (q->head) {
+	    spi_async_poll(q);
+	}
+	return;
+    }
+    WFI_COND(!q->head);
+}
+
+__FAST
+void spi_async_lock(spi_dev_t const *spi)
+{
+    spi_async_queue_t *q = spi_async_queue(spi);
+
+    GLOBAL_INT_DISABLE();
+    q->held++;
+    GLOBAL_INT_RESTORE();
+    // Short transfer; finish it here rather than wait for the interrupt
+    while (q->active) {
+	spi_async_poll(q);
+    }
+}
+
+__FAST
+void spi_async_unlock(spi_dev_t const *spi)
+{
+    spi_async_queue_t *q = spi_async_queue(spi);
+
+    GLOBAL_INT_DISABLE();
+    ASSERT_INFO(q->held, spi, q->head);
+    if (!--q->held && !q->active && q->head) {
+	spi->base->RESET_INTERRUPT = SPI_RESET_INTERRUPT__WRITE;
+	spi->base->RESET_INTERRUPT = 0;
+	spi_async_kick(q);
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+/// Queued transfers do not survive retention; let them drain first
+__FAST
+static rep_vec_err_t spi_async_prevent_ret(bool *prevent, int32_t *pseq_dur,
+    int32_t ble_dur)
+{
+    if (!spi_async_pmu.head && !spi_async_radio.head) {
+	return RV_NEXT;
+    }
+    *prevent = true;
+    return RV_DONE;
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static void spi_async_pmu_isr(void const *arg)
+{
+    spi_async_handler(&spi_pmu);
+}
+
+static void spi_async_radio_isr(void const *arg)
+{
+    spi_async_handler(&spi_radio);
+}
+#elif !defined(SPI_TRANS_WFI)
+// With SPI_TRANS_WFI, spi.c owns these vectors and forwards to us.
+void SPI_PMU_Handler(void)
+{
+    spi_async_handler(&spi_pmu);
+}
+
+void SPI_RADIO_Handler(void)
+{
+    spi_async_handler(&spi_radio);
+}
+#endif
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_SPI)
+#endif
+static void spi_async_constructor(void)
+{
+    RV_PLF_PREVENT_RETENTION_ADD(spi_async_prevent_ret);
+    RV_PLF_PREVENT_HIBERNATION_ADD(spi_async_prevent_ret);
+#ifdef CONFIG_SOC_FAMILY_ATM
+    IRQ_CONNECT(SPI_PMU_IRQn, CONFIG_ATM_SPI_ASYNC_IRQ_PRI, spi_async_pmu_isr,
+	NULL, 0);
+    IRQ_CONNECT(SPI_RADIO_IRQn, CONFIG_ATM_SPI_ASYNC_IRQ_PRI,
+	spi_async_radio_isr, NULL, 0);
+    irq_enable(SPI_PMU_IRQn);
+    irq_enable(SPI_RADIO_IRQn);
+#else
+    NVIC_EnableIRQ(SPI_PMU_IRQn);
+    NVIC_EnableIRQ(SPI_RADIO_IRQn);
+#endif
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int spi_async_sys_init(void)
+{
+    spi_async_constructor();
+    return 0;
+}
+
+SYS_INIT(spi_async_sys_init, PRE_KERNEL_2, 3);
+#endif
@@ -0,0 +1,144 @@
+/**
+ *******************************************************************************
+ *
+ * @file spi_async.h
+ *
+ * @brief Interrupt driven PMU/RADIO SPI transaction queue
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup SPI_ASYNC SPI asynchronous transaction queue
+ * @ingroup SPI
+ * @brief Queue batches of PMU/RADIO register accesses and chain them from
+ * the SPI_PMU/SPI_RADIO interrupt handlers.
+ *
+ * Only the spi_pmu and spi_radio devices are supported.  The synchronous
+ * accessors (PMU_WRITE, RADIO_READ, ...) hold the device with
+ * spi_async_lock(): the transfer on the bus is finished first and the
+ * queue resumes once they are done, so they may be used at any time,
+ * including from interrupt and sleep hooks.  Retention and hibernation are
+ * held off while batches are pending.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "spi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Single PMU/RADIO register access
+typedef struct spi_async_xfer_s {
+    /// Module block
+    uint8_t block;
+    /// Register address within block
+    uint8_t addr;
+    /// Write when true, read otherwise
+    bool write;
+    /// Value to write, or value read once the batch completes
+    uint32_t data;
+} spi_async_xfer_t;
+
+struct spi_async_batch_s;
+
+/**
+ * @brief Batch completion callback (called from interrupt context).
+ * @param[in] batch Completed batch.
+ * @param[in] ctx   Context supplied with the batch.
+ */
+typedef void (*spi_async_cb_t)(struct spi_async_batch_s *batch,
+    void const *ctx);
+
+/// Batch of register accesses, owned by the driver until completion
+typedef struct spi_async_batch_s {
+    /// Register accesses, performed in order
+    spi_async_xfer_t *xfers;
+    /// Number of entries in xfers
+    uint16_t num_xfers;
+    /// Completion callback (optional)
+    spi_async_cb_t cb;
+    /// Callback context
+    void const *ctx;
+    /// @cond PRIVATE
+    struct spi_async_batch_s *next;
+    uint16_t pos;
+    /// @endcond
+} spi_async_batch_t;
+
+/// Initializer for a register write entry
+#define SPI_ASYNC_WRITE(__m, __reg, __val) { \
+    .block = __m ## __REG_BLADDR, \
+    .addr = __m ## __ ## __reg, \
+    .write = true, \
+    .data = (__val), \
+}
+
+/// Initializer for a register read entry
+#define SPI_ASYNC_READ(__m, __reg) { \
+    .block = __m ## __REG_BLADDR, \
+    .addr = __m ## __ ## __reg, \
+    .write = false, \
+}
+
+/**
+ * @brief Queue a batch of register accesses.
+ *
+ * Returns immediately.  The batch and its xfers must remain valid until the
+ * completion callback has been invoked.
+ * @param[in] spi   spi_pmu or spi_radio.
+ * @param[in] batch Batch to queue.
+ */
+void spi_async_submit(spi_dev_t const *spi, spi_async_batch_t *batch);
+
+/**
+ * @brief Check for pending batches.
+ * @param[in] spi spi_pmu or spi_radio.
+ * @return true while batches are queued or in flight.
+ */
+bool spi_async_busy(spi_dev_t const *spi);
+
+/**
+ * @brief Wait until all queued batches have completed.
+ *
+ * Waits in WFI, or polls where the interrupt cannot be taken.
+ * @param[in] spi spi_pmu or spi_radio.
+ */
+void spi_async_flush(spi_dev_t const *spi);
+
+/**
+ * @brief Take the device for a synchronous transaction.
+ *
+ * Completes the queued transfer on the bus, by polling, and keeps the
+ * queue from starting another until spi_async_unlock().  Nests.
+ * @param[in] spi spi_pmu or spi_radio.
+ */
+void spi_async_lock(spi_dev_t const *spi);
+
+/**
+ * @brief Release the device and resume the queue.
+ * @param[in] spi spi_pmu or spi_radio.
+ */
+void spi_async_unlock(spi_dev_t const *spi);
+
+/**
+ * @brief Service a SPI_PMU/SPI_RADIO interrupt.
+ *
+ * Invoked by the SPI interrupt handlers; not for application use.
+ * @param[in] spi spi_pmu or spi_radio.
+ */
+void spi_async_handler(spi_dev_t const *spi);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} SPI_ASYNC
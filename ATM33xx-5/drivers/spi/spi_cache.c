@@ -0,0 +1,217 @@
+/**
+ *******************************************************************************
+ *
+ * @file spi_cache.c
+ *
+ * @brief Shadow register cache for PMU and RADIO SPI blocks
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#endif
+
+#include <string.h>
+#include "arch.h"
+#include "spi.h"
+#include "spi_cache.h"
+#include "pmu_spi.h"
+#include "radio_spi.h"
+
+#ifdef CONFIG_ATM_SPI_CACHE_ENTRIES
+#define SPI_CACHE_ENTRIES CONFIG_ATM_SPI_CACHE_ENTRIES
+#else
+#define SPI_CACHE_ENTRIES 64
+#endif
+STATIC_ASSERT(!(SPI_CACHE_ENTRIES & (SPI_CACHE_ENTRIES - 1)),
+    "SPI_CACHE_ENTRIES must be a power of two");
+
+// Tag 0 marks an empty slot, so a zeroed cache is an empty cache
+#define SPI_CACHE_TAG_VALID 0x8000
+#define SPI_CACHE_TAG(__b, __a) \
+    (SPI_CACHE_TAG_VALID | ((uint16_t)(__b) << 8) | (__a))
+
+/*
+ * Cacheable registers per block, one bit per word address.  Every register
+ * below CORE_ID is cacheable unless its *_regs_core_macro.h definition has
+ * no __WRITE mask, i.e. it is a hardware readback.
+ */
+#define SPI_CACHE_BIT(__addr) (1ULL << ((__addr) >> 2))
+#define SPI_CACHE_BLOCK(__m) \
+    [__m ## __REG_BLADDR] = (SPI_CACHE_BIT(__m ## __CORE_ID_REG_ADDR) - 1)
+
+static uint64_t const spi_cache_pmu_map[16] = {
+    SPI_CACHE_BLOCK(SWREG_AON) &
+	~SPI_CACHE_BIT(SWREG_AON__READOUT_REG_ADDR),
+    SPI_CACHE_BLOCK(SWREG_SIMPLE),
+    SPI_CACHE_BLOCK(SWREG_MAIN) &
+	~(SPI_CACHE_BIT(SWREG_MAIN__READOUT0_REG_ADDR) |
+	SPI_CACHE_BIT(SWREG_MAIN__READOUT1_REG_ADDR) |
+	SPI_CACHE_BIT(SWREG_MAIN__READOUT2_REG_ADDR) |
+	SPI_CACHE_BIT(SWREG_MAIN__READOUT3_REG_ADDR)),
+    SPI_CACHE_BLOCK(PMU_TOP) &
+	~(SPI_CACHE_BIT(PMU_TOP__PMU_RB0_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_TOP__PMU_RB1_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_TOP__PMU_RB2_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_TOP__PMU_RB_MPPT_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_TOP__PMU_RB3_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_TOP__PMU_RB4_REG_ADDR)),
+    SPI_CACHE_BLOCK(PMU_WURX) &
+	~(SPI_CACHE_BIT(PMU_WURX__WURX_RB0_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_WURX__WURX_RB1_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_WURX__WURX_RB2_REG_ADDR)),
+    SPI_CACHE_BLOCK(PMU_GADC),
+    SPI_CACHE_BLOCK(PMU_PMUADC) &
+	~(SPI_CACHE_BIT(PMU_PMUADC__PMUADC_READOUT0_REG_ADDR) |
+	SPI_CACHE_BIT(PMU_PMUADC__PMUADC_READOUT1_REG_ADDR)),
+};
+
+static uint64_t const spi_cache_radio_map[16] = {
+    SPI_CACHE_BLOCK(RADIO_RX) &
+	~SPI_CACHE_BIT(RADIO_RX__STATUS_REG_ADDR),
+    SPI_CACHE_BLOCK(RADIO_SYNTH) &
+	~SPI_CACHE_BIT(RADIO_SYNTH__SYNTH_READOUT_REG_ADDR),
+    SPI_CACHE_BLOCK(RADIO_TOP) &
+	~(SPI_CACHE_BIT(RADIO_TOP__STATUS_REG_ADDR) |
+	SPI_CACHE_BIT(RADIO_TOP__VERSION_REG_ADDR) |
+	SPI_CACHE_BIT(RADIO_TOP__PROCMON_RESULT_REG_ADDR)),
+    SPI_CACHE_BLOCK(PLL) &
+	~SPI_CACHE_BIT(PLL__READOUT_REG_ADDR),
+};
+
+typedef struct {
+    uint64_t const *map;
+    uint16_t tag[SPI_CACHE_ENTRIES];
+    uint32_t data[SPI_CACHE_ENTRIES];
+    spi_cache_stats_t stats;
+} spi_cache_t;
+
+static spi_cache_t spi_cache_pmu = { .map = spi_cache_pmu_map };
+static spi_cache_t spi_cache_radio = { .map = spi_cache_radio_map };
+
+__FAST
+static spi_cache_t *spi_cache_get(spi_dev_t const *spi)
+{
+    if (spi == &spi_pmu) {
+	return &spi_cache_pmu;
+    }
+    if (spi == &spi_radio) {
+	return &spi_cache_radio;
+    }
+    return NULL;
+}
+
+__FAST
+static bool spi_cache_cacheable(spi_cache_t const *cache, uint8_t block,
+    uint8_t addr)
+{
+    return (block < 16) && !(addr & 0x3) &&
+	(cache->map[block] & SPI_CACHE_BIT(addr));
+}
+
+__FAST
+static uint16_t spi_cache_index(uint8_t block, uint8_t addr)
+{
+    // Word addresses are sequential within a block; spread blocks apart.
+    return ((addr >> 2) + (block * 11)) & (SPI_CACHE_ENTRIES - 1);
+}
+
+__FAST
+bool spi_cache_lookup(spi_dev_t const *spi, uint8_t block, uint8_t addr,
+    uint32_t *data)
+{
+    spi_cache_t *cache = spi_cache_get(spi);
+    if (!cache) {
+	return false;
+    }
+    if (!spi_cache_cacheable(cache, block, addr)) {
+	cache->stats.bypass++;
+	return false;
+    }
+
+    uint16_t idx = spi_cache_index(block, addr);
+    bool hit;
+    GLOBAL_INT_DISABLE();
+    hit = (cache->tag[idx] == SPI_CACHE_TAG(block, addr));
+    if (hit) {
+	*data = cache->data[idx];
+	cache->stats.hits++;
+    } else {
+	cache->stats.misses++;
+    }
+    GLOBAL_INT_RESTORE();
+    return hit;
+}
+
+__FAST
+void spi_cache_update(spi_dev_t const *spi, uint8_t block, uint8_t addr,
+    uint32_t data)
+{
+    spi_cache_t *cache = spi_cache_get(spi);
+    if (!cache || !spi_cache_cacheable(cache, block, addr)) {
+	return;
+    }
+
+    uint16_t idx = spi_cache_index(block, addr);
+    GLOBAL_INT_DISABLE();
+    cache->tag[idx] = SPI_CACHE_TAG(block, addr);
+    cache->data[idx] = data;
+    GLOBAL_INT_RESTORE();
+}
+
+__FAST
+void spi_cache_invalidate(spi_dev_t const *spi)
+{
+    spi_cache_t *cache = spi_cache_get(spi);
+    if (cache) {
+	memset(cache->tag, 0, sizeof(cache->tag));
+    }
+}
+
+void spi_cache_stats_get(spi_dev_t const *spi, spi_cache_stats_t *stats,
+    bool reset)
+{
+    spi_cache_t *cache = spi_cache_get(spi);
+    if (!cache) {
+	memset(stats, 0, sizeof(*stats));
+	return;
+    }
+
+    GLOBAL_INT_DISABLE();
+    *stats = cache->stats;
+    if (reset) {
+	memset(&cache->stats, 0, sizeof(cache->stats));
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+__FAST
+static rep_vec_err_t spi_cache_back_from_retain_all(void)
+{
+    spi_cache_invalidate(&spi_pmu);
+    spi_cache_invalidate(&spi_radio);
+    return RV_NEXT;
+}
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_SPI)
+#endif
+static void spi_cache_constructor(void)
+{
+    RV_PLF_BACK_FROM_RETAIN_ALL_ADD(spi_cache_back_from_retain_all);
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int spi_cache_sys_init(void)
+{
+    spi_cache_constructor();
+    return 0;
+}
+
+SYS_INIT(spi_cache_sys_init, PRE_KERNEL_2, 3);
+#endif
@@ -0,0 +1,86 @@
+/**
+ *******************************************************************************
+ *
+ * @file spi_cache.h
+ *
+ * @brief Shadow register cache for PMU and RADIO SPI blocks
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup SPI_CACHE SPI shadow register cache
+ * @ingroup SPI
+ * @brief Write-through cache of PMU/RADIO registers keyed by (block, addr).
+ *
+ * spi_pmuradio_read_word() is served from the cache when the register was
+ * last written or read by firmware.  Registers the hardware updates on its
+ * own (read-only readback, status, version and core ID registers) are never
+ * cached.  The cache is dropped when returning from retention.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "spi.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Cache statistics
+typedef struct spi_cache_stats_s {
+    /// Reads served from the cache
+    uint32_t hits;
+    /// Cacheable reads that went to the bus
+    uint32_t misses;
+    /// Reads of volatile registers (always go to the bus)
+    uint32_t bypass;
+} spi_cache_stats_t;
+
+/**
+ * @brief Look up a register.
+ * @param[in]  spi   Device structure.
+ * @param[in]  block Module block.
+ * @param[in]  addr  Register address.
+ * @param[out] data  Cached value on hit.
+ * @return true on hit.
+ */
+bool spi_cache_lookup(spi_dev_t const *spi, uint8_t block, uint8_t addr,
+    uint32_t *data);
+
+/**
+ * @brief Record a value written to or read from a register.
+ * @param[in] spi   Device structure.
+ * @param[in] block Module block.
+ * @param[in] addr  Register address.
+ * @param[in] data  Register value.
+ */
+void spi_cache_update(spi_dev_t const *spi, uint8_t block, uint8_t addr,
+    uint32_t data);
+
+/**
+ * @brief Drop all cached registers of a device.
+ * @param[in] spi Device structure.
+ */
+void spi_cache_invalidate(spi_dev_t const *spi);
+
+/**
+ * @brief Fetch cache statistics.
+ * @param[in]  spi   Device structure.
+ * @param[out] stats Statistics since boot or last reset.
+ * @param[in]  reset Clear the counters after reading.
+ */
+void spi_cache_stats_get(spi_dev_t const *spi, spi_cache_stats_t *stats,
+    bool reset);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} SPI_CACHE
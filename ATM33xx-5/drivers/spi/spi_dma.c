@@ -0,0 +1,140 @@
+/**
+ *******************************************************************************
+ *
+ * @file spi_dma.c
+ *
+ * @brief DMA driven SPI0/SPI1 bulk transactions
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#include "arch.h"
+#include "spi.h"
+#include "spi_dma.h"
+#include "at_ahb_dma_regs_core_macro.h"
+
+// SPI_PORT_SEL: 0=SPI0 1=SPI1
+#define SPI_DMA_SPI_SEL(__spi) ((__spi)->base == CMSDK_SPI1)
+
+static struct {
+    dma_req_t req;
+    spi_dev_t const *spi;
+    dma_cb_t cb;
+    void const *ctx;
+} spi_dma_cur;
+
+bool spi_dma_capable(spi_dev_t const *spi)
+{
+    return ((spi->base == CMSDK_SPI0) || (spi->base == CMSDK_SPI1));
+}
+
+bool spi_dma_busy(void)
+{
+    return (spi_dma_cur.spi != NULL);
+}
+
+static void spi_dma_cmd(spi_dev_t const *spi, uint8_t cmd_size,
+    uint8_t const *cmd)
+{
+    uint32_t lower = 0;
+    uint32_t upper = 0;
+
+    for (uint8_t i = 1; i < cmd_size; i++) {
+	if (i <= 4) {
+	    lower |= (uint32_t)cmd[i] << ((i - 1) * 8);
+	} else {
+	    upper |= (uint32_t)cmd[i] << ((i - 5) * 8);
+	}
+    }
+    do_spi_transaction(spi, true, cmd[0], cmd_size - 1, upper, lower);
+}
+
+__FAST
+static void spi_dma_done(dma_req_t *req, bool err)
+{
+    spi_dev_t const *spi = req->ctx;
+    ASSERT_INFO(!err, spi, req->size);
+
+    // Let the final byte drain before handing the core back
+    while (spi->base->TRANSACTION_STATUS &
+	SPI_TRANSACTION_STATUS__RUNNING__MASK) {
+	YIELD();
+    }
+    SPI_CTRL__DMA_MODE__CLR(spi->base->CTRL);
+
+    dma_cb_t cb = spi_dma_cur.cb;
+    void const *ctx = spi_dma_cur.ctx;
+    // Release before the callback so it may start the next transaction
+    spi_dma_cur.spi = NULL;
+    if (cb) {
+	cb(ctx);
+    }
+}
+
+bool spi_dma_transaction(spi_dev_t const *spi, uint8_t cmd_size,
+    uint8_t const *cmd, uint32_t size, uint8_t const *tx_buffer,
+    uint8_t *rx_buffer, dma_cb_t cb, void const *ctx)
+{
+    ASSERT_INFO(spi_dma_capable(spi), spi, spi->base);
+    ASSERT_INFO(!tx_buffer ^ !rx_buffer, tx_buffer, rx_buffer);
+    ASSERT_INFO(size && (size <= AT_DMA_SIZE__SIZE__MASK), size, cmd_size);
+    ASSERT_INFO(cmd_size <= SPI_DMA_CMD_MAX, cmd_size, cmd);
+
+    for (;;) {
+	bool claimed = false;
+
+	GLOBAL_INT_DISABLE();
+	if (!spi_dma_cur.spi) {
+	    spi_dma_cur.spi = spi;
+	    claimed = true;
+	}
+	GLOBAL_INT_RESTORE();
+	if (claimed) {
+	    break;
+	}
+	// The transaction in flight cannot complete under this caller
+	if (!dma_can_wait()) {
+	    return false;
+	}
+	WFI_COND(!spi_dma_cur.spi);
+    }
+    spi_dma_cur.cb = cb;
+    spi_dma_cur.ctx = ctx;
+
+    if (cmd_size) {
+	spi_dma_cmd(spi, cmd_size, cmd);
+    }
+
+    CMSDK_AT_APB_SPI_TypeDef *base = spi->base;
+    bool read = (rx_buffer != NULL);
+
+    // SPI core takes its transaction setup from the DMA engine
+    base->TRANSACTION_SETUP = spi_transaction_setup(spi, true, 0, 0);
+    base->TRANSACTION_SETUP_DMA = SPI_TRANSACTION_SETUP_DMA__RWB__WRITE(read);
+    SPI_CTRL__DMA_MODE__SET(base->CTRL);
+
+    dma_req_t *req = &spi_dma_cur.req;
+    *req = (dma_req_t) {
+	.size = size,
+	.spi_sel = SPI_DMA_SPI_SEL(spi),
+	.chan = DMA_CHAN_ANY,
+	.prio = DMA_PRIO_HIGH,
+	.cb = spi_dma_done,
+	.ctx = spi,
+    };
+    if (read) {
+	req->src = (uint32_t)&base->DATA_BYTES_LOWER;
+	req->src_type = DMA_TYPE_PERIPH_MASTER;
+	req->tar = (uint32_t)rx_buffer;
+	req->tar_type = DMA_TYPE_MEM;
+    } else {
+	req->src = (uint32_t)tx_buffer;
+	req->src_type = DMA_TYPE_MEM;
+	req->tar = (uint32_t)&base->DATA_BYTES_LOWER;
+	req->tar_type = DMA_TYPE_PERIPH_MASTER;
+    }
+    dma_submit(req);
+    return true;
+}
@@ -0,0 +1,79 @@
+/**
+ *******************************************************************************
+ *
+ * @file spi_dma.h
+ *
+ * @brief DMA driven SPI0/SPI1 bulk transactions
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup SPI_DMA SPI DMA transactions
+ * @ingroup SPI
+ * @brief Stream long SPI payloads between memory and SPI0/SPI1 with DMA.
+ *
+ * A transaction is an optional command header (up to 9 bytes, sent by the
+ * core with CSN held low) followed by a payload that the DMA engine either
+ * writes from or reads into memory.  The DMA engine can only be routed to
+ * SPI0 or SPI1; use spi_multi_transaction() for other devices.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "spi.h"
+#include "dma.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Largest command header sent ahead of the payload
+#define SPI_DMA_CMD_MAX 9
+
+/**
+ * @brief Check whether a device can be served by the DMA engine.
+ * @param[in] spi Device structure.
+ * @return true for SPI0 and SPI1 devices.
+ */
+bool spi_dma_capable(spi_dev_t const *spi);
+
+/**
+ * @brief Start a DMA transaction (non blocking).
+ *
+ * Waits for a transaction already in flight.  Exactly one of tx_buffer
+ * and rx_buffer must be non-NULL.  CSN is released once the payload has
+ * been transferred, then cb is invoked from the DMA interrupt.  Buffers
+ * must remain valid until then.
+ * @param[in]  spi       SPI0 or SPI1 device structure.
+ * @param[in]  cmd_size  Command header size in bytes (0 to SPI_DMA_CMD_MAX).
+ * @param[in]  cmd       Command header, first byte is the opcode.
+ * @param[in]  size      Payload size in bytes.
+ * @param[in]  tx_buffer Payload to write.
+ * @param[out] rx_buffer Payload to read.
+ * @param[in]  cb        Completion callback (optional).
+ * @param[in]  ctx       Callback context.
+ * @return false if a transaction is in flight and the caller cannot wait
+ * for it (@see dma_can_wait).
+ */
+bool spi_dma_transaction(spi_dev_t const *spi, uint8_t cmd_size,
+    uint8_t const *cmd, uint32_t size, uint8_t const *tx_buffer,
+    uint8_t *rx_buffer, dma_cb_t cb, void const *ctx);
+
+/**
+ * @brief Check for a transaction in flight.
+ * @return true until the completion callback has been invoked.
+ */
+bool spi_dma_busy(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} SPI_DMA
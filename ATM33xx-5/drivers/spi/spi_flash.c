@@ -12,6 +12,8 @@
 #include "arch.h"
 #include "spi.h"
 #include "spi_flash.h"
+#include "spi_multi.h"
+#include "timer.h"
 
 __NR_STATIC uint32_t
 spi_flash_addr_to_lower(uint32_t addr)
@@ -47,20 +49,79 @@ spi_flash_read_word(const spi_dev_t *spi, uint32_t addr)
 	    (spi->base->DATA_BYTES_LOWER >> 24));
 }
 
+// Status register Write In Progress
+#define SPI_FLASH_SR_WIP 0x01
+
+// Timer used to sleep between status polls; none unless configured
+#if !defined(SPI_FLASH_SLEEP_TIMER) && \
+    defined(CONFIG_ATM_SPI_FLASH_SLEEP_TIMER) && \
+    (CONFIG_ATM_SPI_FLASH_SLEEP_TIMER >= 0)
+#define SPI_FLASH_SLEEP_TIMER CONFIG_ATM_SPI_FLASH_SLEEP_TIMER
+#endif
+
+/*
+ * Status polling profiles.  The first poll is delayed by roughly the
+ * typical operation time, then the interval doubles up to a cap.  The
+ * timeout sits well above the datasheet maximum of common parts.
+ */
+typedef struct {
+    uint16_t first_us;
+    uint16_t max_us;
+    uint16_t timeout_ms;
+} spi_flash_wait_t;
+
+static spi_flash_wait_t const spi_flash_wait_pp = { 50, 500, 20 };
+static spi_flash_wait_t const spi_flash_wait_wrsr = { 100, 2000, 100 };
+static spi_flash_wait_t const spi_flash_wait_sus = { 10, 50, 5 };
+static spi_flash_wait_t const spi_flash_wait_se = { 2000, 10000, 1000 };
+static spi_flash_wait_t const spi_flash_wait_be32 = { 10000, 20000, 3000 };
+static spi_flash_wait_t const spi_flash_wait_be64 = { 20000, 40000, 5000 };
+
+__NR_STATIC void
+spi_flash_sleep(uint32_t usec)
+{
+#ifdef CFG_SW_TIMER_DELAY
+    // Shares the slow timer wheel; spins where sleeping is not possible
+    uint32_t ticks = atm_us_to_lpc(usec);
+    if (ticks) {
+	sw_timer_delay(ticks);
+	return;
+    }
+#elif defined(SPI_FLASH_SLEEP_TIMER)
+    IPSR_Type psr = {.w = __get_IPSR()};
+
+    // The timer interrupt must be able to end the sleep; it may be taken
+    if (!psr.b.ISR && !__get_PRIMASK() && !__get_BASEPRI() &&
+	(atm_timer_usleep(SPI_FLASH_SLEEP_TIMER, usec) ==
+	ATM_TIMER_SUCCESS)) {
+	return;
+    }
+#endif
+    atm_timer_udelay(usec);
+}
+
+/**
+ * @brief Poll status register until the flash is idle or the wait times out.
+ * @return Last status read; SPI_FLASH_SR_WIP is still set on timeout.
+ */
 __NR_STATIC uint8_t
-spi_flash_wait_for_no_wip(const spi_dev_t *spi)
+spi_flash_wait_for_no_wip(const spi_dev_t *spi, spi_flash_wait_t const *wait)
 {
-    uint8_t ret;
+    uint32_t then = atm_get_sys_time();
+    uint32_t limit = atm_ms_to_lpc(wait->timeout_ms);
+    uint32_t delay = wait->first_us;
 
-    // FIXME: timeout
     for (;;) {
-	ret = spi_read(spi, 0x05);  // READ STATUS
-	if (!(ret & 0x1)) {
-	    break;
+	uint8_t ret = spi_read(spi, SPI_FLASH_RDSR);
+	if (!(ret & SPI_FLASH_SR_WIP)) {
+	    return ret;
+	}
+	if (atm_get_sys_time() - then >= limit) {
+	    return ret;
 	}
-	YIELD();
+	spi_flash_sleep(delay);
+	delay = (delay * 2 < wait->max_us) ? (delay * 2) : wait->max_us;
     }
-    return ret;
 }
 
 __NR_STATIC void
@@ -92,7 +153,7 @@ spi_flash_write_byte(const spi_dev_t *spi, uint32_t addr, uint8_t data)
     spi_flash_write_enable(spi);
     do_spi_transaction(spi, 0, opcode, 4, 0x0, lower);
 
-    spi_flash_wait_for_no_wip(spi);
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_pp);
 }
 
 void
@@ -105,7 +166,7 @@ spi_flash_write_short(const spi_dev_t *spi, uint32_t addr, uint16_t data)
     spi_flash_write_enable(spi);
     do_spi_transaction(spi, 0, opcode, 5, upper, lower);
 
-    spi_flash_wait_for_no_wip(spi);
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_pp);
 }
 
 void
@@ -118,19 +179,405 @@ spi_flash_write_word(const spi_dev_t *spi, uint32_t addr, uint32_t data)
     spi_flash_write_enable(spi);
     do_spi_transaction(spi, 0, opcode, 7, upper, lower);
 
-    spi_flash_wait_for_no_wip(spi);
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_pp);
+}
+
+__NR_STATIC void
+spi_flash_cmd_addr(uint8_t *cmd, uint8_t opcode, uint32_t addr)
+{
+    cmd[0] = opcode;
+    cmd[1] = addr >> 16;
+    cmd[2] = addr >> 8;
+    cmd[3] = addr;
+}
+
+/**
+ * @brief Read with a single-wire command, 3-byte address and 8 dummy clocks.
+ */
+__NR_STATIC void
+spi_flash_read_cmd(const spi_dev_t *spi, uint8_t opcode, uint32_t addr,
+    uint8_t *buf, uint32_t len)
+{
+    uint8_t cmd[5];
+    spi_flash_cmd_addr(cmd, opcode, addr);
+    cmd[4] = 0;
+
+    spi_multi_transaction(spi, sizeof(cmd), cmd, 0, NULL,
+	SPI_MULTI_FLAG_CS_ENABLE);
+    spi_multi_transaction(spi, 0, NULL, len, buf, SPI_MULTI_FLAG_CS_DISABLE);
+}
+
+void
+spi_flash_read(const spi_dev_t *spi, uint32_t addr, uint8_t *buf,
+    uint32_t len)
+{
+    if (!len) {
+	return;
+    }
+    spi_flash_read_cmd(spi, SPI_FLASH_FREAD, addr, buf, len);
+}
+
+bool
+spi_flash_program(const spi_dev_t *spi, uint32_t addr, uint8_t const *buf,
+    uint32_t len)
+{
+    while (len) {
+	// Page program wraps within a page; never cross a boundary
+	uint32_t chunk = SPI_FLASH_PAGE_SIZE - (addr % SPI_FLASH_PAGE_SIZE);
+	if (chunk > len) {
+	    chunk = len;
+	}
+
+	uint8_t cmd[4];
+	spi_flash_cmd_addr(cmd, SPI_FLASH_PP, addr);
+
+	spi_flash_write_enable(spi);
+	spi_multi_transaction(spi, sizeof(cmd), cmd, 0, NULL,
+	    SPI_MULTI_FLAG_CS_ENABLE);
+	spi_multi_transaction(spi, chunk, buf, 0, NULL,
+	    SPI_MULTI_FLAG_CS_DISABLE);
+	if (spi_flash_wait_for_no_wip(spi, &spi_flash_wait_pp) &
+	    SPI_FLASH_SR_WIP) {
+	    return false;
+	}
+
+	addr += chunk;
+	buf += chunk;
+	len -= chunk;
+    }
+    return true;
+}
+
+static spi_flash_suspend_hook_t const *spi_flash_hook;
+
+void
+spi_flash_erase_suspend_hook(spi_flash_suspend_hook_t const *hook)
+{
+    spi_flash_hook = hook;
+}
+
+// Erase time between a resume and the next suspend
+#define SPI_FLASH_RESUME_MIN_US 400
+// Suspensions may stretch an erase to this many times its timeout
+#define SPI_FLASH_SUSPEND_STRETCH 4
+
+__NR_STATIC bool
+spi_flash_erase_wait(const spi_dev_t *spi, spi_flash_wait_t const *wait,
+    spi_flash_erase_stats_t *stats)
+{
+    uint32_t start = atm_get_sys_time();
+    uint32_t limit = atm_ms_to_lpc(wait->timeout_ms);
+    uint32_t resume_min = atm_us_to_lpc(SPI_FLASH_RESUME_MIN_US);
+    uint32_t resumed = start - resume_min;
+    uint32_t suspended = 0;
+    uint32_t delay = wait->first_us;
+
+    for (;;) {
+	if (!(spi_read(spi, SPI_FLASH_RDSR) & SPI_FLASH_SR_WIP)) {
+	    return true;
+	}
+	// Suspended time does not count against the erase, up to a point
+	uint32_t now = atm_get_sys_time();
+	uint32_t elapsed = now - start;
+	if ((elapsed - suspended >= limit) ||
+	    (elapsed >= limit * SPI_FLASH_SUSPEND_STRETCH)) {
+	    return false;
+	}
+
+	uint32_t nap = delay;
+	spi_flash_suspend_hook_t const *hook = spi_flash_hook;
+	if (hook && hook->pending(hook->ctx)) {
+	    uint32_t ran = now - resumed;
+	    if (ran < resume_min) {
+		// Suspending at once again would keep the erase from progressing
+		uint32_t left = atm_lpc_to_us(resume_min - ran);
+		nap = (left < nap) ? left : nap;
+	    } else {
+		do_spi_transaction(spi, 0, SPI_FLASH_PES, 0, 0x0, 0x0);
+		// WIP drops once the array is idle (suspend latency)
+		if (spi_flash_wait_for_no_wip(spi, &spi_flash_wait_sus) &
+		    SPI_FLASH_SR_WIP) {
+		    return false;
+		}
+		hook->service(hook->ctx);
+		do_spi_transaction(spi, 0, SPI_FLASH_PER, 0, 0x0, 0x0);
+		if (stats) {
+		    stats->suspends++;
+		}
+		resumed = atm_get_sys_time();
+		suspended += resumed - now;
+		continue;
+	    }
+	}
+	spi_flash_sleep(nap);
+	if (nap == delay) {
+	    delay = (delay * 2 < wait->max_us) ? (delay * 2) : wait->max_us;
+	}
+    }
+}
+
+static spi_flash_sfdp_t spi_flash_sfdp;
+static spi_dev_t const *spi_flash_sfdp_dev;
+
+// Erase types assumed when the device has not been probed
+static uint8_t const spi_flash_erase_shift[SPI_FLASH_SFDP_ERASE_TYPES] = {
+    12, 15, 16, 0,
+};
+static uint8_t const spi_flash_erase_opcode[SPI_FLASH_SFDP_ERASE_TYPES] = {
+    SPI_FLASH_SE, SPI_FLASH_BE32, SPI_FLASH_BE64, 0,
+};
+
+bool
+spi_flash_erase(const spi_dev_t *spi, uint32_t addr, uint32_t len,
+    spi_flash_erase_stats_t *stats)
+{
+    uint8_t const *shifts = spi_flash_erase_shift;
+    uint8_t const *opcodes = spi_flash_erase_opcode;
+
+    if (spi_flash_sfdp_dev == spi) {
+	shifts = spi_flash_sfdp.erase_shift;
+	opcodes = spi_flash_sfdp.erase_opcode;
+    }
+
+    // Erases act on whole sectors; a partial one would wipe data past len
+    if ((addr % SPI_FLASH_SECTOR_SIZE) || (len % SPI_FLASH_SECTOR_SIZE)) {
+	return false;
+    }
+
+    if (stats) {
+	*stats = (spi_flash_erase_stats_t){0};
+    }
+
+    while (len) {
+	uint8_t type = SPI_FLASH_SFDP_ERASE_TYPES;
+	spi_flash_wait_t const *wait;
+	uint16_t *count;
+
+	// Largest erase type whose size and alignment fit
+	for (uint8_t i = 0; i < SPI_FLASH_SFDP_ERASE_TYPES; i++) {
+	    if (!shifts[i] || (shifts[i] > 31)) {
+		continue;
+	    }
+	    uint32_t span = 1UL << shifts[i];
+	    if ((addr & (span - 1)) || (span > len)) {
+		continue;
+	    }
+	    if ((type == SPI_FLASH_SFDP_ERASE_TYPES) ||
+		(shifts[i] > shifts[type])) {
+		type = i;
+	    }
+	}
+	if (type == SPI_FLASH_SFDP_ERASE_TYPES) {
+	    return false;
+	}
+
+	uint8_t opcode = opcodes[type];
+	uint32_t size = 1UL << shifts[type];
+	if (size >= SPI_FLASH_BLOCK64_SIZE) {
+	    wait = &spi_flash_wait_be64;
+	    count = stats ? &stats->blocks64 : NULL;
+	} else if (size >= SPI_FLASH_BLOCK32_SIZE) {
+	    wait = &spi_flash_wait_be32;
+	    count = stats ? &stats->blocks32 : NULL;
+	} else {
+	    wait = &spi_flash_wait_se;
+	    count = stats ? &stats->sectors : NULL;
+	}
+
+	uint32_t then = atm_get_sys_time();
+	spi_flash_write_enable(spi);
+	do_spi_transaction(spi, 0, opcode, 3, 0x0,
+	    spi_flash_addr_to_lower(addr));
+	if (!spi_flash_erase_wait(spi, wait, stats)) {
+	    return false;
+	}
+
+	if (stats) {
+	    uint32_t us = atm_lpc_to_us(atm_get_sys_time() - then);
+	    (*count)++;
+	    stats->total_us += us;
+	    if (us > stats->max_us) {
+		stats->max_us = us;
+	    }
+	}
+
+	addr += size;
+	len -= (size < len) ? size : len;
+    }
+    return true;
+}
+
+// SFDP header and parameter header signatures
+#define SFDP_SIGNATURE 0x50444653 // "SFDP"
+#define SFDP_BFPT_ID_LSB 0x00
+#define SFDP_BFPT_ID_MSB 0xff
+// BFPT DWORDs parsed (JESD216B DW1..DW16)
+#define SFDP_BFPT_DWORDS 16
+#define SFDP_DW(__n) bfpt[(__n) - 1]
+
+__NR_STATIC void
+spi_flash_sfdp_read_mode(spi_flash_sfdp_t *sfdp, spi_flash_read_mode_t mode,
+    uint16_t field)
+{
+    // field: [4:0] dummy clocks, [7:5] mode clocks, [15:8] opcode
+    sfdp->read_mode = mode;
+    sfdp->read_opcode = field >> 8;
+    sfdp->read_dummy = (field & 0x1f) + ((field >> 5) & 0x7);
+}
+
+// Largest density exponent (in bits) whose byte count fits the size field
+#define SFDP_DENSITY_LOG2_MAX 34
+
+__NR_STATIC bool
+spi_flash_sfdp_parse(spi_flash_sfdp_t *sfdp, uint32_t const *bfpt,
+    uint8_t dwords)
+{
+    uint32_t dw2 = SFDP_DW(2);
+    if (dw2 & (1UL << 31)) {
+	uint32_t n = dw2 & 0x7fffffff;
+	if ((n < 3) || (n > SFDP_DENSITY_LOG2_MAX)) {
+	    return false;
+	}
+	sfdp->size = 1UL << (n - 3);
+    } else {
+	sfdp->size = (dw2 + 1) / 8;
+    }
+
+    // Fastest read first
+    uint32_t dw1 = SFDP_DW(1);
+    if (dw1 & (1UL << 21)) {
+	spi_flash_sfdp_read_mode(sfdp, SPI_FLASH_MODE_144, SFDP_DW(3));
+    } else if (dw1 & (1UL << 22)) {
+	spi_flash_sfdp_read_mode(sfdp, SPI_FLASH_MODE_114, SFDP_DW(3) >> 16);
+    } else if (dw1 & (1UL << 20)) {
+	spi_flash_sfdp_read_mode(sfdp, SPI_FLASH_MODE_122, SFDP_DW(4) >> 16);
+    } else if (dw1 & (1UL << 16)) {
+	spi_flash_sfdp_read_mode(sfdp, SPI_FLASH_MODE_112, SFDP_DW(4));
+    } else {
+	sfdp->read_mode = SPI_FLASH_MODE_111;
+	sfdp->read_opcode = SPI_FLASH_FREAD;
+	sfdp->read_dummy = 8;
+    }
+
+    // Erase types 1..4: [7:0] size exponent, [15:8] opcode
+    for (uint8_t i = 0; i < SPI_FLASH_SFDP_ERASE_TYPES; i++) {
+	uint16_t type = SFDP_DW(8 + (i / 2)) >> ((i % 2) * 16);
+	sfdp->erase_shift[i] = type & 0xff;
+	sfdp->erase_opcode[i] = type >> 8;
+    }
+
+    // Quad Enable Requirements appeared in JESD216A (DW15)
+    sfdp->qer = (dwords >= 15) ? ((SFDP_DW(15) >> 20) & 0x7) :
+	SPI_FLASH_QER_UNKNOWN;
+    return true;
+}
+
+spi_flash_sfdp_t const *
+spi_flash_sfdp_probe(const spi_dev_t *spi)
+{
+    if (spi_flash_sfdp_dev == spi) {
+	return &spi_flash_sfdp;
+    }
+
+    uint32_t hdr[2];
+    spi_flash_read_cmd(spi, SPI_FLASH_RDSFDP, 0, (uint8_t *)hdr, sizeof(hdr));
+    if (hdr[0] != SFDP_SIGNATURE) {
+	return NULL;
+    }
+
+    // First parameter header is mandated to be the BFPT
+    uint32_t phdr[2];
+    spi_flash_read_cmd(spi, SPI_FLASH_RDSFDP, sizeof(hdr), (uint8_t *)phdr,
+	sizeof(phdr));
+    if (((phdr[0] & 0xff) != SFDP_BFPT_ID_LSB) ||
+	((phdr[1] >> 24) != SFDP_BFPT_ID_MSB)) {
+	return NULL;
+    }
+    uint8_t dwords = phdr[0] >> 24;
+    if (dwords < 9) {
+	return NULL;
+    }
+    if (dwords > SFDP_BFPT_DWORDS) {
+	dwords = SFDP_BFPT_DWORDS;
+    }
+
+    uint32_t bfpt[SFDP_BFPT_DWORDS] = {0};
+    spi_flash_read_cmd(spi, SPI_FLASH_RDSFDP, phdr[1] & 0xffffff,
+	(uint8_t *)bfpt, dwords * sizeof(uint32_t));
+
+    spi_flash_sfdp = (spi_flash_sfdp_t){0};
+    spi_flash_sfdp.jedec_id = spi_read_3(spi, SPI_FLASH_RDID);
+    if (!spi_flash_sfdp_parse(&spi_flash_sfdp, bfpt, dwords)) {
+	return NULL;
+    }
+    spi_flash_sfdp_dev = spi;
+    return &spi_flash_sfdp;
+}
+
+void
+spi_flash_sfdp_forget(void)
+{
+    spi_flash_sfdp_dev = NULL;
+}
+
+/**
+ * @brief Set QE (SR2 bit 1) on parts without a status register 2 read.
+ *
+ * QER 1 and 4 parts only take SR2 as the second byte of a 2-byte WRSR,
+ * so SR1 is read back with 05h and written along unchanged to keep the
+ * block protection bits.  SR2 itself cannot be verified.
+ */
+static bool
+spi_flash_sr2_make_quad(const spi_dev_t *spi)
+{
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_wrsr);
+    uint8_t sr1 = spi_read(spi, SPI_FLASH_RDSR);
+    spi_flash_write_enable(spi);
+
+    // WRITE STATUS REG - SR1 as is, Quad Enable
+    do_spi_transaction(spi, 0, 0x01, 2, 0x0, (sr1 << 8) | 0x02);
+
+    // WIP and WEL aside, SR1 must have taken its own value back
+    uint8_t status = spi_flash_wait_for_no_wip(spi, &spi_flash_wait_wrsr);
+    return ((status & 0xfc) == (sr1 & 0xfc));
+}
+
+bool
+spi_flash_sfdp_make_quad(const spi_dev_t *spi)
+{
+    spi_flash_sfdp_t const *sfdp = spi_flash_sfdp_probe(spi);
+    if (!sfdp) {
+	return false;
+    }
+
+    switch (sfdp->qer) {
+    case 0: // No QE bit
+	return true;
+    case 1: // QE is SR2 bit 1, 2-byte WRSR, no 35h read
+    case 4:
+	return spi_flash_sr2_make_quad(spi);
+    case 5: // QE is SR2 bit 1, 2-byte WRSR, read with 35h
+	return spi_giga_make_quad(spi);
+    case 2: // QE is SR1 bit 6
+	return spi_macronix_make_quad(spi);
+    case 6: // QE is SR2 bit 1, written alone with 31h
+	return spi_winbond_make_quad(spi);
+    default:
+	return false;
+    }
 }
 
 bool
 spi_macronix_make_quad(const spi_dev_t *spi)
 {
-    spi_flash_wait_for_no_wip(spi);
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_wrsr);
     spi_flash_write_enable(spi);
 
     // WRITE STATUS REG - High perf, Quad Enable
     do_spi_transaction(spi, 0, 0x01, 3, 0x0, 0x020040);
 
-    return ((spi_flash_wait_for_no_wip(spi) & 0x40) == 0x40);
+    uint8_t status = spi_flash_wait_for_no_wip(spi, &spi_flash_wait_wrsr);
+    return ((status & 0x40) == 0x40);
 }
 
 /**
@@ -153,13 +600,13 @@ spi_giga_make_quad(const spi_dev_t *spi)
 	return true;
     }
 
-    spi_flash_wait_for_no_wip(spi);
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_wrsr);
     spi_flash_write_enable(spi);
 
     // WRITE STATUS REG - Quad Enable
     do_spi_transaction(spi, 0, 0x01, 2, 0x0, 0x0200);
 
-    spi_flash_wait_for_no_wip(spi);
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_wrsr);
 
     return ((spi_read(spi, 0x35) & 0x02) == 0x02);
 }
@@ -206,7 +653,7 @@ spi_micron_make_quad(const spi_dev_t *spi)
     // READ ENHANCED VOLATILE CONFIGURATION REGISTER
     uint8_t evcr = spi_read(spi, 0x65);
 
-    spi_flash_wait_for_no_wip(spi);
+    spi_flash_wait_for_no_wip(spi, &spi_flash_wait_wrsr);
     spi_flash_write_enable(spi);
 
     // WRITE ENHANCED VOLATILE CONFIGURATION REGISTER
@@ -75,6 +75,75 @@ typedef enum {
     SPI_FLASH_RUID = 0x4b,	// Read Unique ID
 } spi_flash_cmd_t;
 
+/// Page Program burst size
+#define SPI_FLASH_PAGE_SIZE 256
+/// Sector Erase size
+#define SPI_FLASH_SECTOR_SIZE 0x1000
+/// Block Erase (32K) size
+#define SPI_FLASH_BLOCK32_SIZE 0x8000
+/// Block Erase (64K) size
+#define SPI_FLASH_BLOCK64_SIZE 0x10000
+
+/// Erase statistics
+typedef struct {
+    /// Erases under 32K (4K sectors) issued
+    uint16_t sectors;
+    /// Erases of 32K up to 64K issued
+    uint16_t blocks32;
+    /// Erases of 64K or more issued
+    uint16_t blocks64;
+    /// Times an erase was suspended to service reads
+    uint16_t suspends;
+    /// Time spent erasing, including suspensions (microseconds)
+    uint32_t total_us;
+    /// Longest single erase command (microseconds)
+    uint32_t max_us;
+} spi_flash_erase_stats_t;
+
+/// Read protocols (command-address-data lines)
+typedef enum {
+    SPI_FLASH_MODE_111,
+    SPI_FLASH_MODE_112,
+    SPI_FLASH_MODE_122,
+    SPI_FLASH_MODE_114,
+    SPI_FLASH_MODE_144,
+} spi_flash_read_mode_t;
+
+/// Erase types described by SFDP
+#define SPI_FLASH_SFDP_ERASE_TYPES 4
+/// Quad Enable Requirements not described (pre-JESD216A table)
+#define SPI_FLASH_QER_UNKNOWN 0xff
+
+/// Parameters discovered from the SFDP Basic Flash Parameter Table
+typedef struct {
+    /// RDID response: manufacturer in bits [7:0]
+    uint32_t jedec_id;
+    /// Density in bytes
+    uint32_t size;
+    /// Fastest supported read protocol
+    spi_flash_read_mode_t read_mode;
+    /// Read opcode for read_mode
+    uint8_t read_opcode;
+    /// Clocks between address and data for read_mode (dummy + mode)
+    uint8_t read_dummy;
+    /// JESD216 Quad Enable Requirements, or SPI_FLASH_QER_UNKNOWN
+    uint8_t qer;
+    /// Erase size as a power of two per erase type, 0 if unsupported
+    uint8_t erase_shift[SPI_FLASH_SFDP_ERASE_TYPES];
+    /// Erase opcode per erase type
+    uint8_t erase_opcode[SPI_FLASH_SFDP_ERASE_TYPES];
+} spi_flash_sfdp_t;
+
+/// Read interleaving during erase via Program/Erase Suspend
+typedef struct {
+    /// Return true when reads are waiting for the flash
+    bool (*pending)(void const *ctx);
+    /// Perform the waiting reads; called with the erase suspended
+    void (*service)(void const *ctx);
+    /// Context passed to both callbacks
+    void const *ctx;
+} spi_flash_suspend_hook_t;
+
 /**
  * @brief Read data from SPI-connected flash device.
  * @param[in] spi  Device structure.
@@ -124,6 +193,86 @@ void spi_flash_write_short(const spi_dev_t *spi, uint32_t addr, uint16_t data);
  */
 void spi_flash_write_word(const spi_dev_t *spi, uint32_t addr, uint32_t data);
 
+/**
+ * @brief Read a buffer from SPI-connected flash device.
+ *
+ * Uses a single FAST READ transaction with CSN held low throughout.
+ * @param[in]  spi  Device structure.
+ * @param[in]  addr 3-byte address of data in flash.
+ * @param[out] buf  Destination buffer.
+ * @param[in]  len  Number of bytes to read.
+ */
+void spi_flash_read(const spi_dev_t *spi, uint32_t addr, uint8_t *buf,
+    uint32_t len);
+
+/**
+ * @brief Program a buffer into SPI-connected flash device.
+ *
+ * Issues one Page Program burst per (partial) page; the target range must
+ * already be erased.
+ * @param[in] spi  Device structure.
+ * @param[in] addr 3-byte address of data in flash.
+ * @param[in] buf  Data to write to flash device.
+ * @param[in] len  Number of bytes to write.
+ * @return false if the flash stayed busy past the page program timeout.
+ */
+bool spi_flash_program(const spi_dev_t *spi, uint32_t addr, uint8_t const *buf,
+    uint32_t len);
+
+/**
+ * @brief Erase a range of SPI-connected flash device.
+ *
+ * Each step uses the largest erase command whose size and alignment fit
+ * the remaining range.  The erase types come from spi_flash_sfdp_probe()
+ * for the probed device, otherwise 64K block, 32K block and 4K sector.
+ * @param[in]  spi   Device structure.
+ * @param[in]  addr  3-byte address, 4K aligned.
+ * @param[in]  len   Number of bytes to erase, multiple of 4K.
+ * @param[out] stats Erase statistics (optional).
+ * @return false if the range is not 4K aligned, no erase type fits it, or
+ * the flash stayed busy past the erase timeout.
+ */
+bool spi_flash_erase(const spi_dev_t *spi, uint32_t addr, uint32_t len,
+    spi_flash_erase_stats_t *stats);
+
+/**
+ * @brief Install read interleaving for subsequent erases.
+ *
+ * While an erase is busy, hook->pending() is polled between status reads.
+ * When it returns true the erase is suspended (PES), hook->service() is
+ * called to access the flash, and the erase is resumed (PER).  The erase
+ * then runs at least 400 us before it is suspended again.  Suspended time
+ * does not count against the erase timeout, but an erase still fails
+ * after four times its timeout.  The flash must support Program/Erase
+ * Suspend.
+ * @param[in] hook Hook, or NULL to disable interleaving.
+ */
+void spi_flash_erase_suspend_hook(spi_flash_suspend_hook_t const *hook);
+
+/**
+ * @brief Discover flash parameters from SFDP.
+ *
+ * Reads the SFDP header and Basic Flash Parameter Table once; later calls
+ * for the same device return the copy kept in RAM.
+ * @param[in] spi Device structure.
+ * @return Parsed parameters, or NULL if the device has no usable SFDP or
+ * its density does not fit 32 bits.
+ */
+spi_flash_sfdp_t const *spi_flash_sfdp_probe(const spi_dev_t *spi);
+
+/**
+ * @brief Drop the cached SFDP parameters (e.g. after swapping devices).
+ */
+void spi_flash_sfdp_forget(void);
+
+/**
+ * @brief Turn on QE using the method described by SFDP.
+ * @param[in] spi Device structure.
+ * @return Success: true
+ * Failure: false (no SFDP, or an unsupported requirement)
+ */
+bool spi_flash_sfdp_make_quad(const spi_dev_t *spi);
+
 
 /**
  * @brief Turn on QE in remote flash device.
@@ -10,10 +10,91 @@
  *******************************************************************************
  */
 
+#include <string.h>
 #include "arch.h"
 #include "spi_multi.h"
 #include "atm_utils_math.h"
 
+/**
+ * @brief Gather the data bytes of one transaction into register words.
+ *
+ * Full transactions use two fixed size copies, which compile to single
+ * (possibly unaligned) word loads on the M33.
+ */
+__INLINE void
+spi_multi_pack(uint8_t const *src, uint8_t len,
+    uint32_t *lower, uint32_t *upper)
+{
+    if (len == 8) {
+	memcpy(lower, src, sizeof(*lower));
+	memcpy(upper, src + 4, sizeof(*upper));
+	return;
+    }
+    uint32_t words[2] = {0, 0};
+    memcpy(words, src, len);
+    *lower = words[0];
+    *upper = words[1];
+}
+
+/// @brief Scatter register words into the data bytes of one transaction.
+__INLINE void
+spi_multi_unpack(uint8_t *dst, uint8_t len,
+    uint32_t lower, uint32_t upper)
+{
+    if (len == 8) {
+	memcpy(dst, &lower, sizeof(lower));
+	memcpy(dst + 4, &upper, sizeof(upper));
+	return;
+    }
+    uint32_t words[2] = {lower, upper};
+    memcpy(dst, words, len);
+}
+
+#ifdef CFG_SPI_DMA
+#include "spi_dma.h"
+
+#ifdef CONFIG_ATM_SPI_DMA_THRESHOLD
+#define SPI_MULTI_DMA_THRESHOLD CONFIG_ATM_SPI_DMA_THRESHOLD
+#else
+#define SPI_MULTI_DMA_THRESHOLD 32
+#endif
+
+/**
+ * @brief Hand long one-directional transfers to the DMA engine.
+ *
+ * Write-only transfers send the opcode by core and stream the rest; read-only
+ * transfers are streamed entirely.  The transaction must end with CSN
+ * released since the DMA engine raises it after the last byte.  Callers
+ * in an ISR or with interrupts masked keep the PIO path.
+ * @return true if the transfer was performed.
+ */
+static bool spi_multi_dma(spi_dev_t const *spi, uint32_t tx_size,
+    uint8_t const *tx_buffer, uint32_t rx_size, uint8_t *rx_buffer,
+    uint8_t flags)
+{
+    // Without the DMA interrupt the wait below would never end
+    if (!(flags & SPI_MULTI_FLAG_CS_DISABLE) || !spi_dma_capable(spi) ||
+	!dma_can_wait()) {
+	return false;
+    }
+    bool started;
+    if (!rx_size && (tx_size > SPI_MULTI_DMA_THRESHOLD)) {
+	started = spi_dma_transaction(spi, 1, tx_buffer, tx_size - 1,
+	    tx_buffer + 1, NULL, NULL, NULL);
+    } else if (!tx_size && (rx_size > SPI_MULTI_DMA_THRESHOLD)) {
+	started = spi_dma_transaction(spi, 0, NULL, rx_size, NULL, rx_buffer,
+	    NULL, NULL);
+    } else {
+	return false;
+    }
+    if (!started) {
+	return false;
+    }
+    WFI_COND(!spi_dma_busy());
+    return true;
+}
+#endif
+
 void spi_multi_transaction(spi_dev_t const *spi, uint32_t tx_size,
     uint8_t const *tx_buffer, uint32_t rx_size, uint8_t *rx_buffer,
     uint8_t flags)
@@ -24,6 +105,12 @@ void spi_multi_transaction(spi_dev_t const *spi, uint32_t tx_size,
     // Assert if both tx and rx zero
     ASSERT_INFO(!((tx_size == 0) && (rx_size == 0)), tx_size, rx_size);
 
+#ifdef CFG_SPI_DMA
+    if (spi_multi_dma(spi, tx_size, tx_buffer, rx_size, rx_buffer, flags)) {
+	return;
+    }
+#endif
+
     bool csn_stays_low = true;
     bool tx_csn_stays_low = true;
     bool rx_csn_stays_low = true;
@@ -65,18 +152,12 @@ void spi_multi_transaction(spi_dev_t const *spi, uint32_t tx_size,
 	    rx_csn_stays_low = false;
 	}
 	csn_stays_low = tx_csn_stays_low | rx_csn_stays_low;
-	for (uint8_t local_count = 0; local_count <= tx_num_data_bytes;
-	    local_count++) {
-	    if (!local_count) {
-		tx_opcode = tx_buffer[tx_current_data_byte++];
-		write_flag = true;
-	    } else if (local_count <= 4) {
-		lower |= (tx_buffer[tx_current_data_byte++]
-		    << ((local_count - 1) * 8));
-	    } else {
-		upper |= (tx_buffer[tx_current_data_byte++]
-		    << ((local_count - 5) * 8));
-	    }
+	if (tx_num_data_bytes >= 0) {
+	    tx_opcode = tx_buffer[tx_current_data_byte++];
+	    write_flag = true;
+	    spi_multi_pack(&tx_buffer[tx_current_data_byte], tx_num_data_bytes,
+		&lower, &upper);
+	    tx_current_data_byte += tx_num_data_bytes;
 	}
 	uint32_t transaction =
 	    SPI_TRANSACTION_SETUP__DUMMY_CYCLES__WRITE(spi->dummy_cycles) |
@@ -102,21 +183,12 @@ void spi_multi_transaction(spi_dev_t const *spi, uint32_t tx_size,
 	    SPI_TRANSACTION_STATUS__RUNNING__MASK) {
 	    YIELD();
 	}
-	for (uint8_t local_count = 0; local_count <= rx_num_data_bytes;
-	    local_count++) {
-	    if (!local_count) {
-		rx_buffer[rx_current_data_byte] =
-		    ((spi->base->TRANSACTION_STATUS) >> 8) & 0xFF;
-	    } else if (local_count <= 4) {
-		rx_buffer[rx_current_data_byte] =
-		    (spi->base->DATA_BYTES_LOWER >> (8 * (local_count - 1))) &
-		    0xFF;
-	    } else {
-		rx_buffer[rx_current_data_byte] =
-		    (spi->base->DATA_BYTES_UPPER >> (8 * (local_count - 5))) &
-		    0xFF;
-	    }
-	    rx_current_data_byte++;
+	if (rx_num_data_bytes >= 0) {
+	    rx_buffer[rx_current_data_byte++] =
+		((spi->base->TRANSACTION_STATUS) >> 8) & 0xFF;
+	    spi_multi_unpack(&rx_buffer[rx_current_data_byte], rx_num_data_bytes,
+		spi->base->DATA_BYTES_LOWER, spi->base->DATA_BYTES_UPPER);
+	    rx_current_data_byte += rx_num_data_bytes;
 	}
     }
 }
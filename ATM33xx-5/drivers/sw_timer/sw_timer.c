@@ -0,0 +1,492 @@
+/**
+ *******************************************************************************
+ *
+ * @file sw_timer.c
+ *
+ * @brief Software timer wheel on the slow timer
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#include <zephyr/irq.h>
+#endif
+#include "arch.h"
+#include "at_wrpr.h"
+#include "timer.h"
+#include "sw_timer.h"
+#include "at_apb_slwtimer_regs_core_macro.h"
+
+#ifdef CONFIG_ATM_SW_TIMER_IRQ_PRI
+#define SW_TIMER_IRQ_PRI CONFIG_ATM_SW_TIMER_IRQ_PRI
+#else
+#define SW_TIMER_IRQ_PRI 2
+#endif
+
+#define SW_TIMER_LVL_BITS 5
+#define SW_TIMER_SLOTS (1UL << SW_TIMER_LVL_BITS)
+#define SW_TIMER_SLOT_MASK (SW_TIMER_SLOTS - 1)
+#define SW_TIMER_LEVELS 6
+
+// 40-bit count, loaded with all ones and counting down
+#define SW_TIMER_CNT_MASK 0xffffffffffULL
+#define SW_TIMER_CONTROL SLW_CONTROL__AUTO_RELOAD__MASK
+
+// Thresholds this close may pass before the write reaches the 32 kHz domain
+#define SW_TIMER_ARM_MARGIN 2
+
+// Comparator roles
+#define SW_TIMER_CMP_EXPIRY 0
+#define SW_TIMER_CMP_CASCADE 1
+
+// Wakeup overshoot average: 1/8 tick units, new samples weigh 1/8
+#define SW_TIMER_OVERSHOOT_SHIFT 3
+
+#define SW_TIMER_HIT_MASK (SLW_INTERRUPT_STATUS__HIT_THRES0__MASK | \
+    SLW_INTERRUPT_STATUS__HIT_THRES1__MASK)
+
+STATIC_ASSERT(SLW_CONTROL__RESET_THRES0__MASK ==
+    (SLW_INTERRUPT_STATUS__HIT_THRES0__MASK << 2), "sw_timer_irq_clear()");
+STATIC_ASSERT(SLW_INTERRUPT_MASK__PASSTHRU_HIT_THRES0__MASK ==
+    SLW_INTERRUPT_STATUS__HIT_THRES0__MASK, "sw_timer_cmp_set()");
+STATIC_ASSERT((offsetof(CMSDK_AT_APB_SLWTIMER_TypeDef, THRES1_LOW) -
+    offsetof(CMSDK_AT_APB_SLWTIMER_TypeDef, THRES0_LOW)) ==
+    (2 * sizeof(uint32_t)), "Slow timer threshold layout");
+
+static struct {
+    sw_timer_t *slot[SW_TIMER_LEVELS][SW_TIMER_SLOTS];
+    uint32_t occupied[SW_TIMER_LEVELS];
+    // Wheel time: no slot is due before it
+    uint32_t now;
+    uint32_t armed_at[2];
+    bool armed[2];
+} sw_timer_wheel;
+
+// Slow timer loaded and counting
+static bool sw_timer_ready;
+
+static uint32_t sw_timer_overshoot;
+static sw_timer_delay_stats_t sw_timer_delay_stats = {
+    .break_even = SW_TIMER_ARM_MARGIN + 1,
+};
+
+__FAST
+static uint64_t sw_timer_elapsed(void)
+{
+    uint32_t hi;
+    uint32_t lo;
+
+    // The count moves in the 32 kHz domain; read until it holds still
+    do {
+	hi = CMSDK_SLWTIMER->CNT_HIGH;
+	lo = CMSDK_SLWTIMER->CNT_LOW;
+    } while ((lo != CMSDK_SLWTIMER->CNT_LOW) ||
+	(hi != CMSDK_SLWTIMER->CNT_HIGH));
+    return ~(((uint64_t)hi << 32) | lo) & SW_TIMER_CNT_MASK;
+}
+
+__FAST
+uint32_t sw_timer_now(void)
+{
+    if (!sw_timer_ready) {
+	// Early boot: the slow timer count is not running yet
+	return atm_get_sys_time();
+    }
+    return sw_timer_elapsed();
+}
+
+/// Interrupt reset bits are not self clearing
+__FAST
+static void sw_timer_irq_clear(uint32_t hit)
+{
+    CMSDK_SLWTIMER->CONTROL = SW_TIMER_CONTROL | (hit << 2);
+    CMSDK_SLWTIMER->CONTROL = SW_TIMER_CONTROL;
+}
+
+__FAST
+static void sw_timer_cmp_set(int cmp, bool on, uint32_t at)
+{
+    uint32_t hit = SLW_INTERRUPT_STATUS__HIT_THRES0__MASK << cmp;
+
+    if (!on) {
+	if (sw_timer_wheel.armed[cmp]) {
+	    CMSDK_SLWTIMER->INTERRUPT_MASK &= ~hit;
+	    sw_timer_wheel.armed[cmp] = false;
+	}
+	return;
+    }
+    if (sw_timer_wheel.armed[cmp] && (sw_timer_wheel.armed_at[cmp] == at)) {
+	return;
+    }
+    sw_timer_wheel.armed[cmp] = true;
+    sw_timer_wheel.armed_at[cmp] = at;
+
+    CMSDK_SLWTIMER->INTERRUPT_MASK &= ~hit;
+    uint64_t now = sw_timer_elapsed();
+    uint64_t thres = ~(now + (int32_t)(at - (uint32_t)now)) & SW_TIMER_CNT_MASK;
+    __IO uint32_t *reg = &CMSDK_SLWTIMER->THRES0_LOW + (2 * cmp);
+    reg[1] = thres >> 32;
+    reg[0] = thres;
+    sw_timer_irq_clear(hit);
+    CMSDK_SLWTIMER->INTERRUPT_MASK |= hit;
+
+    // The comparator only fires when the count steps onto it
+    if ((int32_t)(at - sw_timer_now()) <= SW_TIMER_ARM_MARGIN) {
+	NVIC_SetPendingIRQ(SLWTIMER_IRQn);
+    }
+}
+
+/// File a timer by how far its expiry is from the wheel time
+__FAST
+static void sw_timer_insert(sw_timer_t *timer)
+{
+    uint32_t now = sw_timer_wheel.now;
+    uint32_t ahead = timer->expires - now;
+    uint32_t lvl = 0;
+
+    if ((int32_t)ahead < 0) {
+	// Late: due at once
+	ahead = 0;
+    }
+    // Lowest level where the expiry is less than a turn ahead
+    while ((ahead >= SW_TIMER_SLOTS) && (lvl < (SW_TIMER_LEVELS - 1))) {
+	lvl++;
+	uint32_t shift = lvl * SW_TIMER_LVL_BITS;
+	ahead = ((timer->expires >> shift) - (now >> shift)) &
+	    (UINT32_MAX >> shift);
+    }
+    if (ahead >= SW_TIMER_SLOTS) {
+	// Beyond the wheel: refiled when the furthest slot comes due
+	ahead = SW_TIMER_SLOT_MASK;
+    }
+
+    uint32_t idx = ((now >> (lvl * SW_TIMER_LVL_BITS)) + ahead) &
+	SW_TIMER_SLOT_MASK;
+    sw_timer_t **head = &sw_timer_wheel.slot[lvl][idx];
+    timer->next = *head;
+    if (*head) {
+	(*head)->pprev = &timer->next;
+    }
+    *head = timer;
+    timer->pprev = head;
+    timer->lvl = lvl;
+    timer->idx = idx;
+    sw_timer_wheel.occupied[lvl] |= 1UL << idx;
+}
+
+__FAST
+static void sw_timer_unlink(sw_timer_t *timer)
+{
+    *timer->pprev = timer->next;
+    if (timer->next) {
+	timer->next->pprev = timer->pprev;
+    }
+    timer->pprev = NULL;
+    if (!sw_timer_wheel.slot[timer->lvl][timer->idx]) {
+	sw_timer_wheel.occupied[timer->lvl] &= ~(1UL << timer->idx);
+    }
+}
+
+/// When the first occupied slot of a level comes due
+__FAST
+static bool sw_timer_due(uint32_t lvl, uint32_t *due)
+{
+    uint32_t occ = sw_timer_wheel.occupied[lvl];
+    if (!occ) {
+	return false;
+    }
+
+    uint32_t shift = lvl * SW_TIMER_LVL_BITS;
+    uint32_t chunk = sw_timer_wheel.now >> shift;
+    uint32_t cur = chunk & SW_TIMER_SLOT_MASK;
+    uint32_t ahead = __builtin_ctz((occ >> cur) |
+	(occ << ((SW_TIMER_SLOTS - cur) & SW_TIMER_SLOT_MASK)));
+
+    // Upper level slots are due when the turn below them starts
+    *due = ahead ? ((chunk + ahead) << shift) : sw_timer_wheel.now;
+    return true;
+}
+
+/// Earliest due slot of levels [from, to)
+__FAST
+static bool sw_timer_next(uint32_t from, uint32_t to, uint32_t *due)
+{
+    uint32_t now = sw_timer_wheel.now;
+    bool any = false;
+
+    for (uint32_t lvl = from; lvl < to; lvl++) {
+	uint32_t at;
+	if (sw_timer_due(lvl, &at) && (!any || ((at - now) < (*due - now)))) {
+	    *due = at;
+	    any = true;
+	}
+    }
+    return any;
+}
+
+/// Move the upper level slots due at the wheel time down
+__FAST
+static void sw_timer_cascade(void)
+{
+    for (uint32_t lvl = SW_TIMER_LEVELS - 1; lvl; lvl--) {
+	uint32_t idx = (sw_timer_wheel.now >> (lvl * SW_TIMER_LVL_BITS)) &
+	    SW_TIMER_SLOT_MASK;
+	sw_timer_t *timer = sw_timer_wheel.slot[lvl][idx];
+
+	sw_timer_wheel.slot[lvl][idx] = NULL;
+	sw_timer_wheel.occupied[lvl] &= ~(1UL << idx);
+	while (timer) {
+	    sw_timer_t *next = timer->next;
+	    sw_timer_insert(timer);
+	    timer = next;
+	}
+    }
+}
+
+/// Next timer expired by @p now, walking the wheel time up to it
+__FAST
+static sw_timer_t *sw_timer_pop(uint32_t now)
+{
+    for (;;) {
+	sw_timer_cascade();
+
+	sw_timer_t *timer =
+	    sw_timer_wheel.slot[0][sw_timer_wheel.now & SW_TIMER_SLOT_MASK];
+	if (timer) {
+	    sw_timer_unlink(timer);
+	    if (timer->period) {
+		timer->expires += timer->period;
+		sw_timer_insert(timer);
+	    }
+	    return timer;
+	}
+
+	uint32_t due;
+	if (!sw_timer_next(0, SW_TIMER_LEVELS, &due) ||
+	    ((int32_t)(due - now) > 0)) {
+	    return NULL;
+	}
+	sw_timer_wheel.now = due;
+    }
+}
+
+/// Point the comparators at the next expiry and the next cascade
+__FAST
+static void sw_timer_reprogram(void)
+{
+    uint32_t at = 0;
+    bool on = sw_timer_next(0, 1, &at);
+    sw_timer_cmp_set(SW_TIMER_CMP_EXPIRY, on, at);
+
+    on = sw_timer_next(1, SW_TIMER_LEVELS, &at);
+    sw_timer_cmp_set(SW_TIMER_CMP_CASCADE, on, at);
+}
+
+/// Bring an idle wheel up to date so new expiries are filed from now
+__FAST
+static void sw_timer_sync(uint32_t now)
+{
+    uint32_t due;
+
+    if (!sw_timer_next(0, SW_TIMER_LEVELS, &due) ||
+	((int32_t)(due - now) > 0)) {
+	sw_timer_wheel.now = now;
+    }
+}
+
+__FAST
+static void sw_timer_handler(void)
+{
+    sw_timer_irq_clear(CMSDK_SLWTIMER->INTERRUPT_STATUS & SW_TIMER_HIT_MASK);
+
+    uint32_t now = sw_timer_now();
+    for (;;) {
+	sw_timer_t *timer;
+	sw_timer_cb_t cb = NULL;
+	void const *ctx = NULL;
+
+	GLOBAL_INT_DISABLE();
+	timer = sw_timer_pop(now);
+	if (timer) {
+	    cb = timer->cb;
+	    ctx = timer->ctx;
+	} else {
+	    sw_timer_reprogram();
+	}
+	GLOBAL_INT_RESTORE();
+	if (!timer) {
+	    break;
+	}
+	cb(timer, ctx);
+    }
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static void sw_timer_isr(void const *arg)
+{
+    sw_timer_handler();
+}
+#else
+void SLWTIMER_Handler(void)
+{
+    sw_timer_handler();
+}
+#endif
+
+void sw_timer_init(sw_timer_t *timer, sw_timer_cb_t cb, void const *ctx)
+{
+    *timer = (sw_timer_t) {
+	.cb = cb,
+	.ctx = ctx,
+    };
+}
+
+__FAST
+void sw_timer_start(sw_timer_t *timer, uint32_t ticks, uint32_t period)
+{
+    ASSERT_INFO((ticks <= SW_TIMER_MAX_TICKS) &&
+	(period <= SW_TIMER_MAX_TICKS), ticks, period);
+
+    GLOBAL_INT_DISABLE();
+    if (timer->pprev) {
+	sw_timer_unlink(timer);
+    }
+    uint32_t now = sw_timer_now();
+    sw_timer_sync(now);
+    timer->expires = now + ticks;
+    timer->period = period;
+    sw_timer_insert(timer);
+    sw_timer_reprogram();
+    GLOBAL_INT_RESTORE();
+}
+
+__FAST
+bool sw_timer_stop(sw_timer_t *timer)
+{
+    bool pending;
+
+    GLOBAL_INT_DISABLE();
+    pending = (timer->pprev != NULL);
+    if (pending) {
+	sw_timer_unlink(timer);
+	sw_timer_reprogram();
+    }
+    GLOBAL_INT_RESTORE();
+    return pending;
+}
+
+bool sw_timer_pending(sw_timer_t const *timer)
+{
+    return (timer->pprev != NULL);
+}
+
+__FAST
+static void sw_timer_delay_wake(sw_timer_t *timer, void const *ctx)
+{
+    *(bool volatile *)ctx = true;
+}
+
+/// Only sleep where the slow timer interrupt can get through
+__FAST
+static bool sw_timer_can_sleep(void)
+{
+    IPSR_Type psr = {.w = __get_IPSR()};
+    return sw_timer_ready && !psr.b.ISR && !__get_PRIMASK() &&
+	!__get_BASEPRI();
+}
+
+__FAST
+void sw_timer_delay(uint32_t ticks)
+{
+    ASSERT_INFO(ticks <= SW_TIMER_MAX_TICKS, ticks, SW_TIMER_MAX_TICKS);
+
+    uint32_t start;
+    uint32_t end;
+    bool sleep = (ticks >= sw_timer_delay_stats.break_even) &&
+	sw_timer_can_sleep();
+
+    if (!sleep) {
+	start = sw_timer_now();
+	while ((end = sw_timer_now()) - start < ticks) {
+	    YIELD();
+	}
+    } else {
+	bool volatile woke = false;
+	sw_timer_t timer;
+
+	sw_timer_init(&timer, sw_timer_delay_wake, (void const *)&woke);
+	start = sw_timer_now();
+	sw_timer_start(&timer, ticks, 0);
+	WFI_COND(woke);
+	end = sw_timer_now();
+    }
+
+    uint32_t took = end - start;
+    GLOBAL_INT_DISABLE();
+    if (sleep) {
+	// Sleeping pays off once the delay outlasts the wakeup lag
+	uint32_t over = (took > ticks) ? (took - ticks) : 0;
+	sw_timer_overshoot += over -
+	    (sw_timer_overshoot >> SW_TIMER_OVERSHOOT_SHIFT);
+	sw_timer_delay_stats.break_even = SW_TIMER_ARM_MARGIN + 1 +
+	    ((sw_timer_overshoot + (1UL << SW_TIMER_OVERSHOOT_SHIFT) - 1) >>
+	    SW_TIMER_OVERSHOOT_SHIFT);
+	sw_timer_delay_stats.sleeps++;
+	sw_timer_delay_stats.sleep_ticks += took;
+    } else {
+	sw_timer_delay_stats.spins++;
+	sw_timer_delay_stats.spin_ticks += took;
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+void sw_timer_delay_stats_get(sw_timer_delay_stats_t *stats, bool reset)
+{
+    GLOBAL_INT_DISABLE();
+    *stats = sw_timer_delay_stats;
+    if (reset) {
+	sw_timer_delay_stats = (sw_timer_delay_stats_t) {
+	    .break_even = stats->break_even,
+	};
+    }
+    GLOBAL_INT_RESTORE();
+}
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_SW_TIMER)
+#endif
+static void sw_timer_constructor(void)
+{
+    WRPR_CTRL_SET(CMSDK_SLWTIMER, WRPR_CTRL__CLK_ENABLE);
+    CMSDK_SLWTIMER->INTERRUPT_MASK = 0;
+    CMSDK_SLWTIMER->INIT_LOW = SLW_INIT_LOW__INIT_LOW__MASK;
+    CMSDK_SLWTIMER->INIT_HIGH = SLW_INIT_HIGH__INIT_HIGH__MASK;
+    CMSDK_SLWTIMER->CONTROL = SW_TIMER_CONTROL | SLW_CONTROL__LOAD__MASK;
+    while (SLW_STATUS__OP_RUNNING__READ(CMSDK_SLWTIMER->STATUS)) {
+	YIELD();
+    }
+    sw_timer_irq_clear(SW_TIMER_HIT_MASK);
+    sw_timer_ready = true;
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+    IRQ_CONNECT(SLWTIMER_IRQn, SW_TIMER_IRQ_PRI, sw_timer_isr, NULL, 0);
+    irq_enable(SLWTIMER_IRQn);
+#else
+    NVIC_EnableIRQ(SLWTIMER_IRQn);
+#endif
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int sw_timer_sys_init(void)
+{
+    sw_timer_constructor();
+    return 0;
+}
+
+SYS_INIT(sw_timer_sys_init, PRE_KERNEL_2, 3);
+#endif
@@ -0,0 +1,149 @@
+/**
+ *******************************************************************************
+ *
+ * @file sw_timer.h
+ *
+ * @brief Software timer wheel on the slow timer
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup SW_TIMER Software timers
+ * @ingroup DRIVERS
+ * @brief Any number of one-shot and periodic timers on ATM_SLWTIMER.
+ *
+ * Timers are kept in a hierarchical wheel: six levels of 32 slots, each
+ * slot of a level spanning a whole turn of the level below.  Start and
+ * stop only link or unlink a timer from a slot.  A timer far in the
+ * future sits in a coarse slot and moves down a level when that slot
+ * comes due, at most once per level.  Nothing runs between deadlines:
+ * the slow timer threshold comparators are set to the next expiry
+ * (THRES0) and the next move (THRES1) only.
+ *
+ * The driver takes over the slow timer; ATM_SLWTIMER must not be used
+ * through atm_timer_setup().  Times are in slow timer (LPC) ticks, see
+ * atm_ms_to_lpc().
+ *
+ * sw_timer_delay() waits in WFI on a one-shot timer instead of polling
+ * the clock.  Delays too short to be worth a wakeup, and delays from
+ * contexts the slow timer interrupt cannot preempt, spin instead.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Longest delay or period in LPC ticks (about 9 hours at 32 kHz)
+#define SW_TIMER_MAX_TICKS (1UL << 30)
+
+struct sw_timer_s;
+
+/**
+ * @brief Expiry callback (called from interrupt context)
+ *
+ * The timer may be restarted or stopped from the callback.
+ * @param[in] timer Expired timer
+ * @param[in] ctx   Application context
+ */
+typedef void (*sw_timer_cb_t)(struct sw_timer_s *timer, void const *ctx);
+
+/// Timer
+typedef struct sw_timer_s {
+    /// @cond PRIVATE
+    struct sw_timer_s *next;
+    struct sw_timer_s **pprev;
+    uint32_t expires;
+    uint32_t period;
+    sw_timer_cb_t cb;
+    void const *ctx;
+    uint8_t lvl;
+    uint8_t idx;
+    /// @endcond
+} sw_timer_t;
+
+/**
+ * @brief Prepare a timer.
+ * @param[out] timer Timer; must stay valid while pending.
+ * @param[in]  cb    Expiry callback.
+ * @param[in]  ctx   Application context.
+ */
+void sw_timer_init(sw_timer_t *timer, sw_timer_cb_t cb, void const *ctx);
+
+/**
+ * @brief Start or restart a timer.
+ *
+ * A late periodic timer catches up: expiries keep their phase.
+ * @param[in] timer  Timer.
+ * @param[in] ticks  Delay to the first expiry in LPC ticks.
+ * @param[in] period Interval of the following expiries; 0 for one-shot.
+ */
+void sw_timer_start(sw_timer_t *timer, uint32_t ticks, uint32_t period);
+
+/**
+ * @brief Stop a timer.
+ * @param[in] timer Timer.
+ * @return true if the timer was pending.
+ */
+bool sw_timer_stop(sw_timer_t *timer);
+
+/**
+ * @brief Check for a timer waiting to expire.
+ * @param[in] timer Timer.
+ * @return true from sw_timer_start() until the last expiry or stop.
+ */
+bool sw_timer_pending(sw_timer_t const *timer);
+
+/**
+ * @brief Slow timer ticks since boot (wraps at 32 bits).
+ *
+ * Reads without masking interrupts.  Before the driver starts, falls
+ * back to atm_get_sys_time(), whose count differs.
+ * @return LPC ticks.
+ */
+uint32_t sw_timer_now(void);
+
+/// Delay statistics
+typedef struct sw_timer_delay_stats_s {
+    /// Delays that spun
+    uint32_t spins;
+    /// Delays that slept
+    uint32_t sleeps;
+    /// Ticks spent spinning
+    uint64_t spin_ticks;
+    /// Ticks spent sleeping, wakeup included
+    uint64_t sleep_ticks;
+    /// Shortest delay that sleeps, from measured wakeups (not reset)
+    uint32_t break_even;
+} sw_timer_delay_stats_t;
+
+/**
+ * @brief Wait for a number of LPC ticks, sleeping when worthwhile.
+ *
+ * Sleeps only from thread context with interrupts enabled and for at
+ * least sw_timer_delay_stats_t::break_even ticks; otherwise spins.  Other
+ * interrupts are served while sleeping.
+ * @param[in] ticks Delay in LPC ticks.
+ */
+void sw_timer_delay(uint32_t ticks);
+
+/**
+ * @brief Fetch delay statistics.
+ * @param[out] stats Statistics since boot or last reset.
+ * @param[in]  reset Clear the counters after reading.
+ */
+void sw_timer_delay_stats_get(sw_timer_delay_stats_t *stats, bool reset);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} SW_TIMER
@@ -0,0 +1,56 @@
+/**
+ ******************************************************************************
+ *
+ * @file lpc_div.h
+ *
+ * @brief 64-bit by 32-bit division through a divisor reciprocal
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ ******************************************************************************
+ */
+
+#ifndef __LPC_DIV_H__
+#define __LPC_DIV_H__
+
+#include <stdint.h>
+
+/// @cond PRIVATE
+// Free of device headers so the host accuracy check can build it; the
+// includer provides __CLZ (CMSIS, or __builtin_clz on the host).
+
+/// Scale of a divisor reciprocal: floor(log2(d))
+#define ATM_LPC_RECIP_SHIFT(d) (31 - __CLZ(d))
+
+/// Divisor reciprocal below 2^32: floor((2^(32 + shift) - 1) / d)
+#define ATM_LPC_RECIP(d) \
+    ((uint32_t)((((uint64_t)1 << (32 + ATM_LPC_RECIP_SHIFT(d))) - 1) / (d)))
+
+/**
+ * @brief Divide by multiplying with a reciprocal
+ *
+ * The reciprocal gives a quotient a little short, and a 32-bit divide of
+ * the remainder settles it, falling back to a full divide if it does not
+ * fit.  Checked against a 64-bit divide by
+ * tools/scripts/lpc_div/test_lpc_div.py.
+ * @param[in] n Dividend
+ * @param[in] d Divisor
+ * @param[in] recip ATM_LPC_RECIP(d)
+ * @param[in] shift ATM_LPC_RECIP_SHIFT(d)
+ * @return n / d
+ */
+static inline uint64_t atm_lpc_div(uint64_t n, uint32_t d, uint32_t recip,
+    uint32_t shift)
+{
+    uint64_t q = (((n >> 32) * recip) +
+	(((uint64_t)(uint32_t)n * recip) >> 32)) >> shift;
+    uint64_t qd = q * d;
+
+    if ((qd <= n) && !((n - qd) >> 32)) {
+	return q + ((uint32_t)(n - qd) / d);
+    }
+    return n / d;
+}
+/// @endcond
+
+#endif // __LPC_DIV_H__
@@ -13,7 +13,12 @@
 #ifndef __TIMER_H__
 #define __TIMER_H__
 
+#include <stdbool.h>
 #include "at_wrpr.h"
+#include "lpc_div.h"
+#ifdef CFG_SW_TIMER_DELAY
+#include "sw_timer.h"
+#endif
 
 /**
  * @defgroup TIMER HW Timer APIs
@@ -177,6 +182,13 @@ __INLINE uint32_t atm_get_sys_time(void)
  */
 __attribute__((weak)) uint32_t lpc_rcos_hz(void);
 
+#ifdef CFG_SW_TIMER_DELAY
+// Slow timer reads that leave interrupts and PSEQ clocks alone
+#define ATM_TIMER_LPC_NOW() sw_timer_now()
+#else
+#define ATM_TIMER_LPC_NOW() atm_get_sys_time()
+#endif
+
 /*
  * Repeat an operation for a finite period of time.
  * Macros mimic do/while syntax:
@@ -187,26 +199,130 @@ __attribute__((weak)) uint32_t lpc_rcos_hz(void);
  */
 #define ATM_TIMER_DO \
     do { \
-	uint32_t then = atm_get_sys_time(); \
+	uint32_t then = ATM_TIMER_LPC_NOW(); \
 	do {
 
 #define ATM_TIMER_WHILE_LPC_DELAY(ticks) \
 	    YIELD(); \
-	} while (atm_get_sys_time() - then < (ticks)); \
+	} while (ATM_TIMER_LPC_NOW() - then < (ticks)); \
     } while (0)
 
 /**
- * @brief Busy wait using CMSDK_PSEQ->CURRENT_REAL_TIME.
+ * @brief Wait using CMSDK_PSEQ->CURRENT_REAL_TIME.
+ *
+ * With CFG_SW_TIMER_DELAY, sleeps in WFI when long enough to pay off,
+ * see sw_timer_delay().
  * @param[in] ticks Delay value in counts of CMSDK_PSEQ->CURRENT_REAL_TIME.
  * @return Success or Error status
  */
 __INLINE void atm_timer_lpc_delay(uint32_t ticks)
 {
+#ifdef CFG_SW_TIMER_DELAY
+    sw_timer_delay(ticks);
+#else
     uint32_t then = atm_get_sys_time();
     while (atm_get_sys_time() - then < ticks) {
 	YIELD();
     }
+#endif
+}
+
+/// LPC rate with a 32.768 kHz crystal
+#define ATM_LPC_XTAL_HZ 32768
+
+/// log2(ATM_LPC_XTAL_HZ)
+#define ATM_LPC_XTAL_SHIFT 15
+
+/**
+ * @brief Check for an LPC running at ATM_LPC_XTAL_HZ
+ *
+ * Known at compile time with CFG_LPC_XTAL_32768, otherwise true when no
+ * RCOS calibration is linked in.
+ */
+static inline bool atm_lpc_is_xtal(void)
+{
+#ifdef CFG_LPC_XTAL_32768
+    return true;
+#else
+    return !lpc_rcos_hz;
+#endif
+}
+
+#ifndef CFG_LPC_XTAL_32768
+/// @cond PRIVATE
+/// RCOS rate with its reciprocal, shared by all LPC conversions
+typedef struct atm_lpc_rcos_s {
+    uint32_t hz;
+    uint32_t recip;
+    uint32_t shift;
+} atm_lpc_rcos_t;
+
+extern atm_lpc_rcos_t atm_lpc_rcos;
+/// @endcond
+
+/**
+ * @brief Refresh the RCOS rate used by LPC conversions
+ *
+ * Conversions use a snapshot of lpc_rcos_hz() and its reciprocal rather
+ * than fetching the rate each time.  The snapshot is taken at boot and
+ * on wake from retention; RCOS calibration calls this once a new
+ * measurement is in.
+ */
+void atm_lpc_rcos_update(void);
+
+/// @cond PRIVATE
+/// Snapshot of the RCOS rate; before the first refresh, made on the spot
+static inline atm_lpc_rcos_t atm_lpc_rcos_get(void)
+{
+    atm_lpc_rcos_t rcos;
+
+    // Rate and reciprocal must belong together
+    GLOBAL_INT_DISABLE();
+    rcos = atm_lpc_rcos;
+    GLOBAL_INT_RESTORE();
+    if (!rcos.hz) {
+	rcos.hz = lpc_rcos_hz();
+	rcos.recip = ATM_LPC_RECIP(rcos.hz);
+	rcos.shift = ATM_LPC_RECIP_SHIFT(rcos.hz);
+    }
+    return rcos;
+}
+
+static inline uint32_t atm_lpc_rcos_hz(void)
+{
+    uint32_t hz = atm_lpc_rcos.hz;
+    return hz ? hz : lpc_rcos_hz();
+}
+/// @endcond
+#endif // CFG_LPC_XTAL_32768
+
+/**
+ * @brief Fetch LP clock frequency
+ * @return Value in Hz
+ */
+static inline uint32_t atm_lpc_hz(void)
+{
+#ifdef CFG_LPC_XTAL_32768
+    return ATM_LPC_XTAL_HZ;
+#else
+    return atm_lpc_is_xtal() ? ATM_LPC_XTAL_HZ : atm_lpc_rcos_hz();
+#endif
+}
+
+/// @cond PRIVATE
+
+/// Divide by a unit rate; folds the reciprocal when the rate is a constant
+static inline uint64_t atm_lpc_div_const(uint64_t n, uint32_t freq)
+{
+#ifdef __GNUC__
+    if (__builtin_constant_p(freq)) {
+	return atm_lpc_div(n, freq, ATM_LPC_RECIP(freq),
+	    ATM_LPC_RECIP_SHIFT(freq));
+    }
+#endif
+    return n / freq;
 }
+/// @endcond
 
 /**
  * @brief Translate duration to LPC cycles
@@ -216,11 +332,10 @@ __INLINE void atm_timer_lpc_delay(uint32_t ticks)
  */
 static inline uint64_t atm_to_lpc(uint32_t freq, uint64_t cnt)
 {
-    if (lpc_rcos_hz) {
-        return (cnt * lpc_rcos_hz()) / freq;
-    } else {
-        return (cnt * 32768) / freq;
+    if (atm_lpc_is_xtal()) {
+	return atm_lpc_div_const(cnt << ATM_LPC_XTAL_SHIFT, freq);
     }
+    return atm_lpc_div_const(cnt * atm_lpc_hz(), freq);
 }
 
 /**
@@ -231,11 +346,11 @@ static inline uint64_t atm_to_lpc(uint32_t freq, uint64_t cnt)
  */
 static inline uint64_t atm_to_lpc_round(uint32_t freq, uint64_t cnt)
 {
-    if (lpc_rcos_hz) {
-	return ((cnt * lpc_rcos_hz()) + (freq / 2)) / freq;
-    } else {
-	return ((cnt * 32768) + (freq / 2)) / freq;
+    if (atm_lpc_is_xtal()) {
+	return atm_lpc_div_const((cnt << ATM_LPC_XTAL_SHIFT) + (freq / 2),
+	    freq);
     }
+    return atm_lpc_div_const((cnt * atm_lpc_hz()) + (freq / 2), freq);
 }
 
 /**
@@ -276,11 +391,16 @@ static inline uint32_t atm_us_to_lpc(uint64_t us)
  */
 static inline uint64_t atm_lpc_to(uint32_t freq, uint64_t lpc)
 {
-    if (lpc_rcos_hz) {
-        return (lpc * freq) / lpc_rcos_hz();
-    } else {
-        return (lpc * freq) / 32768;
+#ifdef CFG_LPC_XTAL_32768
+    return (lpc * freq) >> ATM_LPC_XTAL_SHIFT;
+#else
+    if (atm_lpc_is_xtal()) {
+	return (lpc * freq) >> ATM_LPC_XTAL_SHIFT;
     }
+
+    atm_lpc_rcos_t rcos = atm_lpc_rcos_get();
+    return atm_lpc_div(lpc * freq, rcos.hz, rcos.recip, rcos.shift);
+#endif
 }
 
 /**
@@ -0,0 +1,67 @@
+/**
+ ******************************************************************************
+ *
+ * @file timer_lpc.c
+ *
+ * @brief RCOS rate shared by the LPC conversions of timer.h
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ ******************************************************************************
+ */
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+#include <zephyr/kernel.h>
+#include <soc.h>
+#include <zephyr/init.h>
+#endif
+#include "arch.h"
+#include "timer.h"
+
+atm_lpc_rcos_t atm_lpc_rcos;
+
+void atm_lpc_rcos_update(void)
+{
+    if (atm_lpc_is_xtal()) {
+	return;
+    }
+    uint32_t hz = lpc_rcos_hz();
+    if (!hz) {
+	// Not measured yet; conversions keep asking lpc_rcos_hz()
+	return;
+    }
+
+    atm_lpc_rcos_t rcos = {
+	.hz = hz,
+	.recip = ATM_LPC_RECIP(hz),
+	.shift = ATM_LPC_RECIP_SHIFT(hz),
+    };
+    GLOBAL_INT_DISABLE();
+    atm_lpc_rcos = rcos;
+    GLOBAL_INT_RESTORE();
+}
+
+static rep_vec_err_t atm_lpc_rcos_wake(void)
+{
+    atm_lpc_rcos_update();
+    return RV_NEXT;
+}
+
+#ifndef CONFIG_SOC_FAMILY_ATM
+__CONSTRUCTOR_PRIO(CONSTRUCTOR_LPC_RCOS)
+#endif
+static void atm_lpc_rcos_constructor(void)
+{
+    atm_lpc_rcos_update();
+    RV_PLF_BACK_FROM_RETAIN_ALL_ADD(atm_lpc_rcos_wake);
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static int atm_lpc_rcos_sys_init(void)
+{
+    atm_lpc_rcos_constructor();
+    return 0;
+}
+
+SYS_INIT(atm_lpc_rcos_sys_init, PRE_KERNEL_2, 6);
+#endif
@@ -0,0 +1,142 @@
+/**
+ *******************************************************************************
+ *
+ * @file uart_baud.c
+ *
+ * @brief UART baud rate detection and switching
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#include "arch.h"
+#include "atm_bp_clock.h"
+#include "timer.h"
+#include "uart_baud.h"
+#include "at_apb_uart_regs_core_macro.h"
+
+// Largest rate error a UART frame tolerates comfortably, in percent
+#define UART_BAUD_TOLERANCE 2
+
+static CMSDK_AT_APB_UART_TypeDef *uart_baud_base(uint8_t port)
+{
+    ASSERT_INFO(port <= 1, port, 0);
+    return port ? CMSDK_UART1 : CMSDK_AT_UART0;
+}
+
+/// Discard what arrived at the previous rate and clear the overrun flag
+static void uart_baud_rx_drain(CMSDK_AT_APB_UART_TypeDef *base)
+{
+    while (CMSDK_AT_UART_STATE__RXBF__READ(base->STATE)) {
+	(void)base->DATA;
+    }
+    base->STATE = CMSDK_AT_UART_STATE__RXOR__MASK;
+}
+
+uint32_t uart_baud_div(uint32_t baud)
+{
+    if (!baud) {
+	return 0;
+    }
+    uint32_t clk = atm_bp_clock_get();
+    uint32_t div = (clk + (baud / 2)) / baud;
+    if ((div < UART_BAUD_DIV_MIN) ||
+	(div > CMSDK_AT_UART_BAUDDIV__BAUD_DIV__MASK)) {
+	return 0;
+    }
+
+    // Rounding to a whole divisor must not pull the rate out of tolerance
+    uint32_t actual = clk / div;
+    uint32_t err = (actual > baud) ? (actual - baud) : (baud - actual);
+    if ((uint64_t)err * 100 > (uint64_t)baud * UART_BAUD_TOLERANCE) {
+	return 0;
+    }
+    return div;
+}
+
+uint32_t uart_baud_rate(uint32_t div)
+{
+    return div ? (atm_bp_clock_get() / div) : 0;
+}
+
+uint32_t uart_baud_get_div(uint8_t port)
+{
+    return CMSDK_AT_UART_BAUDDIV__BAUD_DIV__READ(uart_baud_base(port)->BAUDDIV);
+}
+
+uint32_t uart_baud_set_div(uint8_t port, uint32_t div)
+{
+    ASSERT_INFO((div >= UART_BAUD_DIV_MIN) &&
+	(div <= CMSDK_AT_UART_BAUDDIV__BAUD_DIV__MASK), port, div);
+
+    CMSDK_AT_APB_UART_TypeDef *base = uart_baud_base(port);
+    uint32_t prev = CMSDK_AT_UART_BAUDDIV__BAUD_DIV__READ(base->BAUDDIV);
+
+    // A frame cut in half by the switch would garble the peer's view
+    while (!CMSDK_AT_UART_STATE__TX_IDLE__READ(base->STATE)) {
+	YIELD();
+    }
+    CMSDK_AT_UART_BAUDDIV__BAUD_DIV__MODIFY(base->BAUDDIV, div);
+    uart_baud_rx_drain(base);
+    return prev;
+}
+
+uint32_t uart_baud_detect(uint8_t port, uint32_t min_baud,
+    uint32_t timeout_ms)
+{
+    CMSDK_AT_APB_UART_TypeDef *base = uart_baud_base(port);
+    uint32_t prev = CMSDK_AT_UART_BAUDDIV__BAUD_DIV__READ(base->BAUDDIV);
+    uint32_t ceil = CMSDK_AT_UART_BAUD_DIV_CEIL__BAUDDIV_CEIL__MASK;
+
+    if (min_baud && ((atm_bp_clock_get() / min_baud) < ceil)) {
+	ceil = atm_bp_clock_get() / min_baud;
+    }
+    CMSDK_AT_UART_BAUD_DIV_CEIL__BAUDDIV_CEIL__MODIFY(base->BAUD_DIV_CEIL,
+	ceil);
+    uart_baud_rx_drain(base);
+    CMSDK_AT_UART_BAUD_RATE_DETECT__BRD__SET(base->BAUD_RATE_DETECT);
+
+    // Hardware clears BRD once BAUDDIV holds the measured value
+    uint32_t then = atm_get_sys_time();
+    uint32_t ticks = atm_ms_to_lpc(timeout_ms);
+    while (CMSDK_AT_UART_BAUD_RATE_DETECT__BRD__READ(base->BAUD_RATE_DETECT)) {
+	if (atm_get_sys_time() - then >= ticks) {
+	    CMSDK_AT_UART_BAUD_RATE_DETECT__BRD__CLR(base->BAUD_RATE_DETECT);
+	    CMSDK_AT_UART_BAUDDIV__BAUD_DIV__MODIFY(base->BAUDDIV, prev);
+	    return 0;
+	}
+	YIELD();
+    }
+
+    // The measured frame itself is not reliably received
+    uart_baud_rx_drain(base);
+    return CMSDK_AT_UART_BAUDDIV__BAUD_DIV__READ(base->BAUDDIV);
+}
+
+bool uart_baud_tx_wait_busy(uint8_t port, uint32_t timeout_ms)
+{
+    CMSDK_AT_APB_UART_TypeDef *base = uart_baud_base(port);
+    uint32_t then = atm_get_sys_time();
+    uint32_t ticks = atm_ms_to_lpc(timeout_ms);
+
+    while (CMSDK_AT_UART_STATE__TX_IDLE__READ(base->STATE)) {
+	if (atm_get_sys_time() - then >= ticks) {
+	    return false;
+	}
+	YIELD();
+    }
+    return true;
+}
+
+bool uart_baud_line_errors(uint8_t port)
+{
+    CMSDK_AT_APB_UART_TypeDef *base = uart_baud_base(port);
+    uint32_t state = base->STATE;
+
+    if (CMSDK_AT_UART_STATE__RXOR__READ(state)) {
+	base->STATE = CMSDK_AT_UART_STATE__RXOR__MASK;
+    }
+    return CMSDK_AT_UART_STATE__STOP_BIT_ERR__READ(state) ||
+	CMSDK_AT_UART_STATE__RXOR__READ(state);
+}
@@ -0,0 +1,107 @@
+/**
+ *******************************************************************************
+ *
+ * @file uart_baud.h
+ *
+ * @brief UART baud rate detection and switching
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup UART_BAUD UART baud rate
+ * @ingroup DRIVERS
+ * @brief Divisor calculation, hardware rate detection and rate changes.
+ *
+ * Detection sets BAUD_RATE_DETECT.BRD; the UART then times the start bit
+ * of the next frame and loads BAUDDIV itself.  The measured frame must
+ * start with a single low bit, i.e. have bit 0 set (0x01, 0x55, ...).
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/// Smallest divisor the UART accepts
+#define UART_BAUD_DIV_MIN 8
+
+/**
+ * @brief Divisor for a baud rate at the current bp clock.
+ * @param[in] baud Baud rate.
+ * @return Divisor, or 0 if the rate cannot be generated within 2%.
+ */
+uint32_t uart_baud_div(uint32_t baud);
+
+/**
+ * @brief Baud rate for a divisor at the current bp clock.
+ * @param[in] div Divisor.
+ * @return Baud rate.
+ */
+uint32_t uart_baud_rate(uint32_t div);
+
+/**
+ * @brief Read the divisor in use.
+ * @param[in] port 0 for UART0, 1 for UART1.
+ * @return Divisor.
+ */
+uint32_t uart_baud_get_div(uint8_t port);
+
+/**
+ * @brief Change the divisor between frames.
+ *
+ * Waits for the transmitter to go idle, loads the divisor, drops any
+ * byte received at the old rate and clears the line errors.
+ * @param[in] port 0 for UART0, 1 for UART1.
+ * @param[in] div  New divisor.
+ * @return Previous divisor.
+ */
+uint32_t uart_baud_set_div(uint8_t port, uint32_t div);
+
+/**
+ * @brief Detect the rate of the peer (blocking).
+ *
+ * Frames slower than min_baud restart the measurement.  On timeout the
+ * previous divisor is restored.
+ * @param[in] port       0 for UART0, 1 for UART1.
+ * @param[in] min_baud   Slowest rate to accept; 0 for the slowest the
+ * hardware can measure.
+ * @param[in] timeout_ms Time to wait for the peer.
+ * @return Detected divisor, or 0 on timeout.
+ */
+uint32_t uart_baud_detect(uint8_t port, uint32_t min_baud,
+    uint32_t timeout_ms);
+
+/**
+ * @brief Wait for the transmitter to start sending (blocking).
+ *
+ * Used with uart_baud_set_div() to switch only after a frame handed to the
+ * UART by another context has gone out.
+ * @param[in] port       0 for UART0, 1 for UART1.
+ * @param[in] timeout_ms Time to wait.
+ * @return false if the transmitter stayed idle.
+ */
+bool uart_baud_tx_wait_busy(uint8_t port, uint32_t timeout_ms);
+
+/**
+ * @brief Check for the symptoms of a wrong rate.
+ *
+ * The receive overrun flag is cleared; the stop bit error flag is read
+ * only and follows the last frame.
+ * @param[in] port 0 for UART0, 1 for UART1.
+ * @return true on a stop bit error or an overrun since the last check.
+ */
+bool uart_baud_line_errors(uint8_t port);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} UART_BAUD
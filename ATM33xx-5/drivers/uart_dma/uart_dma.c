@@ -0,0 +1,335 @@
+/**
+ *******************************************************************************
+ *
+ * @file uart_dma.c
+ *
+ * @brief DMA driven UART transport with ring buffers and idle flush
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#include <string.h>
+#include "arch.h"
+#include "dma.h"
+#include "timer.h"
+#include "uart_dma.h"
+#include "at_apb_uart_regs_core_macro.h"
+
+STATIC_ASSERT((DMA_FIFO_RX_UART1 == 1) && (DMA_FIFO_TX_UART1 == 1),
+    "UART port numbering");
+
+static CMSDK_AT_APB_UART_TypeDef *uart_dma_base(uart_dma_t const *uart)
+{
+    return uart->cfg.port ? CMSDK_UART1 : CMSDK_AT_UART0;
+}
+
+/// Point the receive request at the next free span; false when full
+__FAST
+static bool uart_dma_rx_next(uart_dma_t *uart)
+{
+    uint32_t space = uart->cfg.rx_size - uart->rx_count;
+    if (!space) {
+	uart->stats.rx_stalls++;
+	return false;
+    }
+
+    uint32_t len = uart->cfg.rx_size - uart->rx_head;
+    if (len > space) {
+	len = space;
+    }
+    if (len > uart->cfg.rx_chunk) {
+	len = uart->cfg.rx_chunk;
+    }
+    uart->rx_req.tar = (uint32_t)uart->cfg.rx_ring + uart->rx_head;
+    uart->rx_req.size = len;
+    return true;
+}
+
+__FAST
+static void uart_dma_rx_commit(uart_dma_t *uart, uint32_t len)
+{
+    uart->rx_head += len;
+    if (uart->rx_head == uart->cfg.rx_size) {
+	uart->rx_head = 0;
+    }
+    uart->rx_count += len;
+    uart->stats.rx_bytes += len;
+}
+
+__FAST
+static void uart_dma_rx_arm(uart_dma_t *uart)
+{
+    if (!uart->rx_armed && (uart->rx_chan >= 0) && uart_dma_rx_next(uart)) {
+	uart->rx_armed = true;
+	uart->rx_moved = 0;
+	dma_submit(&uart->rx_req);
+    }
+}
+
+/**
+ * @brief Hand received bytes to the application.
+ *
+ * Runs from the DMA and the timer interrupt; whichever gets here first
+ * delivers everything, including bytes committed meanwhile by the other.
+ */
+__FAST
+static void uart_dma_rx_flush(uart_dma_t *uart)
+{
+    bool busy;
+
+    GLOBAL_INT_DISABLE();
+    busy = uart->rx_flushing;
+    uart->rx_flushing = true;
+    GLOBAL_INT_RESTORE();
+    if (busy) {
+	return;
+    }
+
+    for (;;) {
+	uint32_t tail;
+	uint32_t len;
+
+	GLOBAL_INT_DISABLE();
+	tail = uart->rx_tail;
+	len = uart->cfg.rx_size - tail;
+	if (len > uart->rx_count) {
+	    len = uart->rx_count;
+	}
+	if (!len) {
+	    uart->rx_flushing = false;
+	    // Resume after a full ring
+	    uart_dma_rx_arm(uart);
+	}
+	GLOBAL_INT_RESTORE();
+	if (!len) {
+	    break;
+	}
+
+	uart->cfg.rx_cb(uart->cfg.rx_ring + tail, len, uart->cfg.ctx);
+
+	GLOBAL_INT_DISABLE();
+	uart->rx_tail = (tail + len == uart->cfg.rx_size) ? 0 : (tail + len);
+	uart->rx_count -= len;
+	GLOBAL_INT_RESTORE();
+    }
+}
+
+__FAST
+static bool uart_dma_rx_rearm(dma_req_t *req)
+{
+    uart_dma_t *uart = (uart_dma_t *)req->ctx;
+
+    uart_dma_rx_commit(uart, req->size);
+    // New chunk; the idle timer starts counting it from nothing
+    uart->rx_moved = 0;
+    return uart_dma_rx_next(uart);
+}
+
+__FAST
+static void uart_dma_rx_progress(dma_req_t *req)
+{
+    uart_dma_rx_flush((uart_dma_t *)req->ctx);
+}
+
+__FAST
+static void uart_dma_rx_done(dma_req_t *req, bool err)
+{
+    uart_dma_t *uart = (uart_dma_t *)req->ctx;
+
+    // Full ring (rearm declined) or error; flush re-arms once drained
+    uart->rx_armed = false;
+    if (err) {
+	uart->stats.errors++;
+    }
+    uart_dma_rx_flush(uart);
+}
+
+/// Cut a quiet chunk short so its bytes are not held back
+__FAST
+static void uart_dma_idle(void *ctx)
+{
+    uart_dma_t *uart = ctx;
+    bool idle = false;
+
+    GLOBAL_INT_DISABLE();
+    if (uart->rx_armed) {
+	// Quiet: bytes waiting and none arrived since the last tick
+	uint32_t moved = dma_chan_progress(uart->rx_chan);
+	idle = moved && (moved == uart->rx_moved);
+	uart->rx_moved = moved;
+    }
+    if (idle) {
+	uint32_t moved = dma_chan_abort(uart->rx_chan);
+	uart->rx_armed = false;
+	if (moved) {
+	    uart_dma_rx_commit(uart, moved);
+	    uart->stats.idle_flushes++;
+	}
+    }
+    GLOBAL_INT_RESTORE();
+
+    if (idle) {
+	// Delivers what was cut short and re-arms
+	uart_dma_rx_flush(uart);
+    }
+}
+
+__FAST
+static void uart_dma_tx_kick(uart_dma_t *uart)
+{
+    if (uart->tx_busy || !uart->tx_count) {
+	return;
+    }
+    uint32_t len = uart->cfg.tx_size - uart->tx_tail;
+    if (len > uart->tx_count) {
+	len = uart->tx_count;
+    }
+    uart->tx_busy = true;
+    uart->tx_req.src = (uint32_t)uart->cfg.tx_ring + uart->tx_tail;
+    uart->tx_req.size = len;
+    dma_submit(&uart->tx_req);
+}
+
+__FAST
+static void uart_dma_tx_done(dma_req_t *req, bool err)
+{
+    uart_dma_t *uart = (uart_dma_t *)req->ctx;
+
+    if (err) {
+	uart->stats.errors++;
+    }
+    uart->tx_tail += req->size;
+    if (uart->tx_tail == uart->cfg.tx_size) {
+	uart->tx_tail = 0;
+    }
+    uart->tx_count -= req->size;
+    uart->stats.tx_bytes += req->size;
+    uart->tx_busy = false;
+    uart_dma_tx_kick(uart);
+}
+
+uint32_t uart_dma_write(uart_dma_t *uart, uint8_t const *buf, uint32_t len)
+{
+    uint32_t done = 0;
+
+    while (done < len) {
+	uint32_t head;
+	uint32_t space;
+
+	GLOBAL_INT_DISABLE();
+	head = uart->tx_head;
+	space = uart->cfg.tx_size - uart->tx_count;
+	GLOBAL_INT_RESTORE();
+
+	uint32_t n = uart->cfg.tx_size - head;
+	if (n > space) {
+	    n = space;
+	}
+	if (n > (len - done)) {
+	    n = len - done;
+	}
+	if (!n) {
+	    break;
+	}
+	// Only this function moves tx_head, so copy outside the lock
+	memcpy(uart->cfg.tx_ring + head, buf + done, n);
+	done += n;
+
+	GLOBAL_INT_DISABLE();
+	uart->tx_head = (head + n == uart->cfg.tx_size) ? 0 : (head + n);
+	uart->tx_count += n;
+	uart_dma_tx_kick(uart);
+	GLOBAL_INT_RESTORE();
+    }
+    return done;
+}
+
+bool uart_dma_tx_busy(uart_dma_t const *uart)
+{
+    return (uart->tx_count != 0);
+}
+
+bool uart_dma_open(uart_dma_t *uart, uart_dma_cfg_t const *cfg)
+{
+    ASSERT_INFO(cfg->port <= 1, cfg->port, cfg->rx_size);
+    ASSERT_INFO(cfg->rx_size && cfg->rx_chunk && cfg->tx_size && cfg->rx_cb,
+	cfg->rx_size, cfg->tx_size);
+
+    // Receive re-arms itself; nothing may queue behind it
+    int chan = dma_chan_claim(DMA_PRIO_HIGH);
+    if (chan < 0) {
+	return false;
+    }
+    if (atm_timer_setup(cfg->idle_timer, ATM_TIMER_MODE_PERIODIC,
+	uart_dma_idle) != ATM_TIMER_SUCCESS) {
+	dma_chan_release(chan);
+	return false;
+    }
+
+    *uart = (uart_dma_t) {
+	.cfg = *cfg,
+	.rx_req = {
+	    .tar_type = DMA_TYPE_MEM,
+	    .chan = chan,
+	    .cb = uart_dma_rx_done,
+	    .ctx = uart,
+	    .rearm = uart_dma_rx_rearm,
+	    .progress = uart_dma_rx_progress,
+	},
+	.tx_req = {
+	    .src_type = DMA_TYPE_MEM,
+	    .chan = DMA_CHAN_ANY,
+	    .prio = DMA_PRIO_HIGH,
+	    .cb = uart_dma_tx_done,
+	    .ctx = uart,
+	},
+	.rx_chan = chan,
+    };
+    dma_fifo_rx_req(cfg->port, &uart->rx_req);
+    dma_fifo_tx_req(cfg->port, &uart->tx_req);
+
+    CMSDK_AT_APB_UART_TypeDef *base = uart_dma_base(uart);
+    if (cfg->rts_trig_lvl) {
+	// Hardware drives nRTS from the RX FIFO level
+	CMSDK_AT_UART_HW_FLOW_OVRD__RTS_TRIG_LVL__MODIFY(base->HW_FLOW_OVRD,
+	    cfg->rts_trig_lvl);
+	CMSDK_AT_UART_HW_FLOW_OVRD__NRTS_OVRD__CLR(base->HW_FLOW_OVRD);
+    }
+    // FIFO interrupts are consumed by the DMA engine
+    CMSDK_AT_UART_CTRL__RXIRQEN__CLR(base->CTRL);
+    CMSDK_AT_UART_CTRL__TXIRQEN__CLR(base->CTRL);
+    CMSDK_AT_UART_CTRL__DMAMRX__SET(base->CTRL);
+    CMSDK_AT_UART_CTRL__DMAMTX__SET(base->CTRL);
+
+    uart_dma_rx_arm(uart);
+    if (atm_timer_start(cfg->idle_timer, cfg->idle_us, uart) !=
+	ATM_TIMER_SUCCESS) {
+	// Without the idle flush a quiet line would strand received bytes
+	uart_dma_close(uart);
+	return false;
+    }
+    return true;
+}
+
+void uart_dma_close(uart_dma_t *uart)
+{
+    atm_timer_stop(uart->cfg.idle_timer);
+    WFI_COND(!uart->tx_busy);
+
+    GLOBAL_INT_DISABLE();
+    if (uart->rx_armed) {
+	uart_dma_rx_commit(uart, dma_chan_abort(uart->rx_chan));
+	uart->rx_armed = false;
+    }
+    dma_chan_release(uart->rx_chan);
+    // Keeps uart_dma_rx_flush() from re-arming
+    uart->rx_chan = -1;
+    GLOBAL_INT_RESTORE();
+    uart_dma_rx_flush(uart);
+
+    CMSDK_AT_APB_UART_TypeDef *base = uart_dma_base(uart);
+    CMSDK_AT_UART_CTRL__DMAMRX__CLR(base->CTRL);
+    CMSDK_AT_UART_CTRL__DMAMTX__CLR(base->CTRL);
+}
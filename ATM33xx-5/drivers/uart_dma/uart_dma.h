@@ -0,0 +1,152 @@
+/**
+ *******************************************************************************
+ *
+ * @file uart_dma.h
+ *
+ * @brief DMA driven UART transport with ring buffers and idle flush
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#pragma once
+
+/**
+ * @defgroup UART_DMA UART DMA transport
+ * @ingroup DRIVERS
+ * @brief Byte stream over UART0/UART1 without per-byte interrupts.
+ *
+ * Received bytes are drained by DMA into a ring in chunks.  A chunk that
+ * holds bytes but takes no more for a whole idle period is cut short and
+ * handed over, so short packets are not held back; a quiet line with an
+ * empty chunk is left alone.  When the ring is full the
+ * DMA is not re-armed: the RX FIFO fills up and hardware flow control
+ * deasserts nRTS until the application catches up.  Transmit data is
+ * copied into a second ring and sent by DMA.
+ * @{
+ */
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "dma.h"
+#include "timer.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Received data callback (called from interrupt context)
+ *
+ * Data is delivered in order; a ring wrap splits it in two calls.
+ * @param[in] buf Received bytes, valid until the callback returns
+ * @param[in] len Number of bytes
+ * @param[in] ctx Application context
+ */
+typedef void (*uart_dma_rx_cb_t)(uint8_t const *buf, uint32_t len,
+    void const *ctx);
+
+/// Transport configuration
+typedef struct uart_dma_cfg_s {
+    /// 0 for UART0, 1 for UART1
+    uint8_t port;
+    /// Open RX FIFO slots at which nRTS is deasserted; 0 leaves RTS alone
+    uint8_t rts_trig_lvl;
+    /// Timer driving the idle flush
+    atm_timer_id_t idle_timer;
+    /// Idle period in microseconds
+    uint32_t idle_us;
+    /// Receive ring
+    uint8_t *rx_ring;
+    /// Receive ring size in bytes
+    uint32_t rx_size;
+    /// Largest DMA transfer into the receive ring
+    uint32_t rx_chunk;
+    /// Transmit ring
+    uint8_t *tx_ring;
+    /// Transmit ring size in bytes
+    uint32_t tx_size;
+    /// Received data callback
+    uart_dma_rx_cb_t rx_cb;
+    /// Callback context
+    void const *ctx;
+} uart_dma_cfg_t;
+
+/// Transport statistics
+typedef struct uart_dma_stats_s {
+    /// Bytes received
+    uint32_t rx_bytes;
+    /// Bytes sent
+    uint32_t tx_bytes;
+    /// Chunks cut short by the idle timer
+    uint32_t idle_flushes;
+    /// Times the receive ring was full (nRTS held off the host)
+    uint32_t rx_stalls;
+    /// DMA errors
+    uint32_t errors;
+} uart_dma_stats_t;
+
+/// Transport state
+typedef struct uart_dma_s {
+    /// @cond PRIVATE
+    uart_dma_cfg_t cfg;
+    dma_req_t rx_req;
+    dma_req_t tx_req;
+    uint32_t rx_head;
+    uint32_t rx_tail;
+    uint32_t rx_count;
+    uint32_t tx_head;
+    uint32_t tx_tail;
+    uint32_t tx_count;
+    int rx_chan;
+    uint32_t rx_moved;
+    bool rx_armed;
+    bool rx_flushing;
+    bool tx_busy;
+    /// @endcond
+    /// Statistics since uart_dma_open()
+    uart_dma_stats_t stats;
+} uart_dma_t;
+
+/**
+ * @brief Take over a UART for DMA transfers.
+ *
+ * The UART must already be configured (baud rate, pins, enables).
+ * @param[out] uart Transport state; must stay valid until closed.
+ * @param[in]  cfg  Configuration, copied.
+ * @return false if no DMA channel could be claimed or cfg->idle_timer
+ * could not be set up.
+ */
+bool uart_dma_open(uart_dma_t *uart, uart_dma_cfg_t const *cfg);
+
+/**
+ * @brief Stop DMA transfers and hand the UART back.
+ *
+ * Received bytes still in the ring are delivered first.
+ * @param[in] uart Transport.
+ */
+void uart_dma_close(uart_dma_t *uart);
+
+/**
+ * @brief Queue bytes for transmission (non blocking).
+ * @param[in] uart Transport.
+ * @param[in] buf  Bytes to send.
+ * @param[in] len  Number of bytes.
+ * @return Number of bytes accepted into the transmit ring.
+ */
+uint32_t uart_dma_write(uart_dma_t *uart, uint8_t const *buf, uint32_t len);
+
+/**
+ * @brief Check for bytes not yet handed to the UART.
+ * @param[in] uart Transport.
+ * @return true while the transmit ring is not empty.
+ */
+bool uart_dma_tx_busy(uart_dma_t const *uart);
+
+#ifdef __cplusplus
+}
+#endif
+
+/// @} UART_DMA
@@ -95,6 +95,13 @@ extern "C" {
 #define CONSTRUCTOR_LED		106	// Before drivers configure pinmux
 #define CONSTRUCTOR_DTOP_BYPASS	107	// Can change sysclk
 #define CONSTRUCTOR_PINMUX	108	// After HW_CFG; check BOARD
+#define CONSTRUCTOR_DMA		109	// Before DMA clients
+#define CONSTRUCTOR_PWM_FIFO	110	// After DMA
+#define CONSTRUCTOR_I2S_DMA	111	// After DMA
+#define CONSTRUCTOR_SW_TIMER	112	// Slow timer owner
+#define CONSTRUCTOR_MONO_TIME	113	// After SW_TIMER
+#define CONSTRUCTOR_HR_TIMER	114	// Dual timer owner
+#define CONSTRUCTOR_LPC_RCOS	115	// LPC conversion rate
 #define CONSTRUCTOR_MAIN	198	// Main constructor
 #define CONSTRUCTOR_USER_INIT	199	// Last numbered constructor
 // Followed by unnumbered constructors
@@ -173,6 +180,7 @@ extern "C" {
 
 /// Hardware compatibility
 #define CMSDK_AES       CMSDK_AES_NONSECURE
+#define CMSDK_DMA	CMSDK_AT_DMA_NONSECURE
 #define CMSDK_GADC	CMSDK_GADC_NONSECURE
 #define CMSDK_I2C0	CMSDK_I2C0_NONSECURE
 #define CMSDK_I2C1	CMSDK_I2C1_NONSECURE
@@ -174,6 +174,34 @@ extern uint16_t cal_pub_addr_len;
     } \
 } while (0)
 
+/// Queue a PMU TOP calibration field, if present, into a batch table
+#define PMU_TOP_CAL_ENTRY(__regs, __num, __s, __f, __reg) do { \
+    if (CAL_PRESENT(__s, __f)) { \
+	(__regs)[(__num)++] = \
+	    (spi_pmuradio_reg_t)PMU_BATCH_ENTRY(TOP, __reg, __s.__f); \
+    } \
+} while (0)
+
+/**
+ * Write every PMU TOP calibration field present in one batch, in the
+ * order of the individual PMU_TOP_CAL() writes it replaces.
+ */
+#define PMU_TOP_CAL_ALL() do { \
+    spi_pmuradio_reg_t cal_regs[4]; \
+    uint16_t cal_num = 0; \
+    PMU_TOP_CAL_ENTRY(cal_regs, cal_num, cust_cfg, PMU_TOP_PMU2, \
+	PMU2_REG_ADDR); \
+    PMU_TOP_CAL_ENTRY(cal_regs, cal_num, misc_cal, PMU_TOP_PMU2A, \
+	PMU2A_REG_ADDR); \
+    PMU_TOP_CAL_ENTRY(cal_regs, cal_num, misc_cal, PMU_TOP_PMU3, \
+	PMU3_REG_ADDR); \
+    PMU_TOP_CAL_ENTRY(cal_regs, cal_num, misc_cal, PMU_TOP_PMU4, \
+	PMU4_REG_ADDR); \
+    __UNUSED uint16_t cal_mismatches = spi_pmuradio_write_batch(&spi_pmu, \
+	cal_regs, cal_num, VERIFY_SPI_CAL); \
+    ASSERT_INFO(!cal_mismatches, cal_mismatches, cal_num); \
+} while (0)
+
 #ifdef __cplusplus
 }
 #endif
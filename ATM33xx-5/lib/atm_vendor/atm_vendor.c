@@ -76,6 +76,11 @@
 #include "atm_coremark_port.h"
 #endif
 
+#ifdef CFG_VND_BAUD
+#include "uart_baud.h"
+#include "timer.h"
+#endif
+
 #ifdef CONFIG_SOC_FAMILY_ATM
 #ifndef H4_MSG_LC_HCI_EVT
 #define H4_MSG_LC_HCI_EVT 0x04
@@ -180,6 +185,10 @@ static union {
     // vendor_stage: VENDOR_NO_CLOCK
     // vendor_stage: VENDOR_WHILE_ONE
     power_cmd_t power_cmd;
+#endif
+#ifdef CFG_VND_BAUD
+    // vendor_stage: VENDOR_BAUD
+    baud_cmd_t baud_cmd;
 #endif
     uint8_t dummy;
 } dat;
@@ -1304,6 +1313,173 @@ static void vendor_while_one_cmp_handler(uint8_t **bufptr, uint32_t *size)
 }
 #endif
 
+#ifdef CFG_VND_BAUD
+#ifndef CFG_VND_BAUD_PORT
+#define CFG_VND_BAUD_PORT 1
+#endif
+#ifndef CFG_VND_BAUD_TIMER
+#define CFG_VND_BAUD_TIMER ATM_TIMER1
+#endif
+#ifndef CFG_VND_BAUD_WINDOW_MS
+#define CFG_VND_BAUD_WINDOW_MS 500
+#endif
+#ifndef CFG_VND_BAUD_DETECT_MS
+#define CFG_VND_BAUD_DETECT_MS 0
+#endif
+#ifndef CFG_VND_BAUD_DETECT_MIN
+#define CFG_VND_BAUD_DETECT_MIN 9600
+#endif
+// Time for the HCI transport to start sending the completion event
+#define VND_BAUD_EVT_START_MS 20
+
+/*
+ * Rate change handshake:
+ * 1. host sends BAUD(rate) at the old rate, the event comes back at the
+ *    old rate and the UART moves to the new divisor afterwards.
+ * 2. host repeats BAUD(rate) at the new rate within the window; a clean
+ *    reception confirms the new divisor.
+ * No repeat within the window, a different rate or line errors put the
+ * old divisor back.
+ */
+// Divisor to load once the pending event is out
+static uint32_t baud_next_div;
+// Divisor to fall back to; non-zero while the new one is unconfirmed
+static uint32_t baud_prev_div;
+// The pending load starts a handshake (false for a rollback)
+static bool baud_probe;
+// CFG_VND_BAUD_TIMER is ours; no rate change without the rollback
+static bool baud_timer_ready;
+
+static void vendor_baud_apply(void)
+{
+    uint32_t prev = uart_baud_set_div(CFG_VND_BAUD_PORT, baud_next_div);
+    DEBUG_TRACE("baud: %" PRIu32, uart_baud_rate(baud_next_div));
+    if (!baud_probe) {
+	return;
+    }
+    baud_prev_div = prev;
+    if (atm_timer_start(CFG_VND_BAUD_TIMER, CFG_VND_BAUD_WINDOW_MS * 1000,
+	NULL) != ATM_TIMER_SUCCESS) {
+	// Nothing would roll back; the handshake at the new rate fails
+	DEBUG_TRACE("baud: no window timer, rollback");
+	baud_prev_div = 0;
+	uart_baud_set_div(CFG_VND_BAUD_PORT, prev);
+    }
+}
+
+/// Take the unconfirmed handshake, if any, from whoever gets there first
+__FAST
+static uint32_t vendor_baud_take_prev(void)
+{
+    uint32_t prev;
+
+    GLOBAL_INT_DISABLE();
+    atm_timer_stop(CFG_VND_BAUD_TIMER);
+    prev = baud_prev_div;
+    baud_prev_div = 0;
+    GLOBAL_INT_RESTORE();
+    return prev;
+}
+
+#ifdef CONFIG_SOC_FAMILY_ATM
+static void baud_work_handler(struct k_work *work)
+{
+    // The work can run before the HCI thread has written the event
+    if (!uart_baud_tx_wait_busy(CFG_VND_BAUD_PORT, VND_BAUD_EVT_START_MS)) {
+	DEBUG_TRACE("baud: event not seen on the line");
+    }
+    vendor_baud_apply();
+}
+static K_WORK_DEFINE(baud_work, baud_work_handler);
+#else
+__FAST
+static void baud_deferred_cb(sw_event_id_t event_id, const void *ctx)
+{
+    vendor_baud_apply();
+}
+static sw_event_id_t baud_eid;
+#endif
+
+/**
+ * Load baud_next_div after the completion event has gone out.
+ * The rep vector build runs the sw_event once the UART write hook that
+ * produced the event has handed it to the driver.  The Zephyr work item
+ * first waits for the transmitter to start on the event; either way
+ * uart_baud_set_div() then waits for it to drain.
+ */
+static void vendor_baud_defer(bool probe)
+{
+    baud_probe = probe;
+#ifdef CONFIG_SOC_FAMILY_ATM
+    k_work_submit(&baud_work);
+#else
+    sw_event_set(baud_eid);
+#endif
+}
+
+__FAST
+static void vendor_baud_timeout(void *ctx)
+{
+    uint32_t prev = vendor_baud_take_prev();
+
+    if (!prev) {
+	return;
+    }
+    DEBUG_TRACE("baud: no handshake, rollback");
+    uart_baud_set_div(CFG_VND_BAUD_PORT, prev);
+}
+
+static void vendor_baud_init(void)
+{
+#ifndef CONFIG_SOC_FAMILY_ATM
+    baud_eid = sw_event_alloc(baud_deferred_cb, NULL);
+#endif
+    baud_timer_ready = (atm_timer_setup(CFG_VND_BAUD_TIMER,
+	ATM_TIMER_MODE_SINGLE_SHOT, vendor_baud_timeout) == ATM_TIMER_SUCCESS);
+    if (!baud_timer_ready) {
+	DEBUG_TRACE("baud: timer %d unavailable", CFG_VND_BAUD_TIMER);
+    }
+#if CFG_VND_BAUD_DETECT_MS
+    // Follow the host before anything is sent at the default rate
+    uint32_t div = uart_baud_detect(CFG_VND_BAUD_PORT,
+	CFG_VND_BAUD_DETECT_MIN, CFG_VND_BAUD_DETECT_MS);
+    DEBUG_TRACE("baud detect: %" PRIu32, uart_baud_rate(div));
+#endif
+}
+
+static void vendor_baud_handler(uint8_t *buf)
+{
+    dat.baud_cmd.baud = atm_get_le32(buf);
+}
+
+static void vendor_baud_cmp_handler(uint8_t **bufptr, uint32_t *size)
+{
+    uint32_t div = uart_baud_div(dat.baud_cmd.baud);
+
+    init_hci_event(BAUD_CMD_OCF, BAUD_CMD_OGF, 0, HCI_EVT_SUCCESS, bufptr,
+	size);
+    // The window timer may have rolled back already; then this is new
+    uint32_t prev = vendor_baud_take_prev();
+    if (prev) {
+	// Handshake at the new rate
+	if ((div != uart_baud_get_div(CFG_VND_BAUD_PORT)) ||
+	    uart_baud_line_errors(CFG_VND_BAUD_PORT)) {
+	    SET_HCI_EVT_STATUS(HCI_EVT_ERROR);
+	    baud_next_div = prev;
+	    vendor_baud_defer(false);
+	}
+	return;
+    }
+
+    if (!div || !baud_timer_ready) {
+	SET_HCI_EVT_STATUS(HCI_EVT_ERROR);
+	return;
+    }
+    baud_next_div = div;
+    vendor_baud_defer(true);
+}
+#endif
+
 static void vendor_exit_vendor_mode_handler(uint8_t *buf)
 {
     memset(&dat, 0, sizeof(dat));
@@ -1397,6 +1573,10 @@ static struct vendor_handler const vendor_handler_tab[] = {
     {WHILE_ONE_CMD_OCF, WHILE_ONE_CMD_OGF, WHILE_ONE_CMD_LEN, true,
 	vendor_while_one_handler, vendor_while_one_cmp_handler},
 #endif
+#ifdef CFG_VND_BAUD
+    {BAUD_CMD_OCF, BAUD_CMD_OGF, BAUD_CMD_LEN, true, vendor_baud_handler,
+	vendor_baud_cmp_handler},
+#endif
 #ifdef CFG_VND_DBG_MMR
     {RD_MEM_CMD_OCF, RD_MEM_CMD_OGF, RD_MEM_CMD_LEN, true,
 	vendor_dbg_rd_mem_handler, vendor_dbg_rd_mem_cmp_handler},
@@ -1641,6 +1821,9 @@ static int sys_vendor_init(void)
     }
 #endif
     atm_uart_init();
+#ifdef CFG_VND_BAUD
+    vendor_baud_init();
+#endif
     return 0;
 }
 SYS_INIT(sys_vendor_init, APPLICATION, CONFIG_KERNEL_INIT_PRIORITY_DEVICE);
@@ -1697,6 +1880,10 @@ void vendor_specific_init(void)
     RV_APPM_INIT_ADD(atm_vendor_tx_pwr_init);
 #endif
 
+#ifdef CFG_VND_BAUD
+    vendor_baud_init();
+#endif
+
     ag_ready_evt = malloc(sizeof(AG_READY_EVT));
 }
 #endif // CONFIG_SOC_FAMILY_ATM
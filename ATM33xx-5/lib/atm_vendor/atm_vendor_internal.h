@@ -61,6 +61,7 @@ typedef enum {
     MFG_OCF_WFI,
     MFG_OCF_NO_CLOCK,
     MFG_OCF_WHILE_ONE,
+    MFG_OCF_BAUD,
 
     MFG_OCF_END
 } MFG_OCF;
@@ -184,6 +185,11 @@ typedef enum {
 #define WHILE_ONE_CMD_OGF MFG_OGF_SB1
 #define WHILE_ONE_CMD_LEN 0x03
 
+// Baud rate (0xF814)
+#define BAUD_CMD_OCF MFG_OCF_BAUD
+#define BAUD_CMD_OGF MFG_OGF_SB1
+#define BAUD_CMD_LEN 0x04
+
 // bit Defines for WFI, NO_CLOCK power config, used in power measure tests
 #define PWR_BP_FREQ_ADJUST 0x0001
 #define PWR_BLE52_DISABLE 0x0002
@@ -549,6 +555,16 @@ typedef struct {
 #define WHILE_ONE_CMD 0
 #endif
 
+#ifdef CFG_VND_BAUD
+#define BAUD_CMD 1
+typedef struct {
+    // requested baud rate
+    uint32_t baud;
+} baud_cmd_t;
+#else
+#define BAUD_CMD 0
+#endif
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,103 @@
+/**
+ *******************************************************************************
+ *
+ * @file lpc_div_check.c
+ *
+ * @brief Host check of atm_lpc_div() against a 64-bit divide
+ *
+ * Every divisor up to LPC_DIV_CHECK_MAX_D, and divisors around each power
+ * of two above it, is run through dividends at every power of two, at
+ * multiples of the divisor around them, at the top of the range and at
+ * pseudo-random points.  Exits non-zero after the first divisor with a
+ * wrong quotient.
+ *
+ * Copyright (C) Atmosic 2024
+ *
+ *******************************************************************************
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#define __CLZ(x) __builtin_clz(x)
+#include "lpc_div.h"
+
+#ifndef LPC_DIV_CHECK_MAX_D
+#define LPC_DIV_CHECK_MAX_D (1UL << 20)
+#endif
+
+#define LPC_DIV_CHECK_RANDOM 16
+
+static uint64_t checked;
+
+static uint64_t xorshift(uint64_t *state)
+{
+    *state ^= *state << 13;
+    *state ^= *state >> 7;
+    *state ^= *state << 17;
+    return *state;
+}
+
+static int check_one(uint64_t n, uint32_t d, uint32_t recip, uint32_t shift)
+{
+    uint64_t q = atm_lpc_div(n, d, recip, shift);
+
+    checked++;
+    if (q != n / d) {
+	printf("atm_lpc_div(%" PRIu64 ", %" PRIu32 ") = %" PRIu64
+	    ", expected %" PRIu64 "\n", n, d, q, n / d);
+	return 1;
+    }
+    return 0;
+}
+
+static int check_divisor(uint32_t d)
+{
+    uint32_t recip = ATM_LPC_RECIP(d);
+    uint32_t shift = ATM_LPC_RECIP_SHIFT(d);
+    uint64_t state = 0x9e3779b97f4a7c15ULL ^ d;
+    int err = 0;
+
+    for (uint8_t k = 0; k < 64; k++) {
+	uint64_t m = (uint64_t)1 << k;
+	uint64_t md = (m / d) * d;
+	err |= check_one(m - 1, d, recip, shift);
+	err |= check_one(m, d, recip, shift);
+	err |= check_one(m + 1, d, recip, shift);
+	err |= check_one(md, d, recip, shift);
+	err |= check_one(md - 1, d, recip, shift);
+	err |= check_one(md + d - 1, d, recip, shift);
+    }
+    err |= check_one(UINT64_MAX, d, recip, shift);
+    err |= check_one(UINT64_MAX - d, d, recip, shift);
+    err |= check_one((UINT64_MAX / d) * d, d, recip, shift);
+    err |= check_one((UINT64_MAX / d) * d - 1, d, recip, shift);
+    for (uint8_t i = 0; i < LPC_DIV_CHECK_RANDOM; i++) {
+	uint64_t n = xorshift(&state);
+	err |= check_one(n, d, recip, shift);
+	err |= check_one(n >> (n & 63), d, recip, shift);
+    }
+    return err;
+}
+
+int main(void)
+{
+    for (uint32_t d = 1; d <= LPC_DIV_CHECK_MAX_D; d++) {
+	if (check_divisor(d)) {
+	    return 1;
+	}
+    }
+    for (uint8_t s = 21; s < 32; s++) {
+	uint32_t p = 1UL << s;
+	for (uint32_t off = 0; off < 256; off++) {
+	    if (check_divisor(p + off) || check_divisor(p - off - 1)) {
+		return 1;
+	    }
+	}
+    }
+    if (check_divisor(UINT32_MAX)) {
+	return 1;
+    }
+    printf("%" PRIu64 " quotients exact\n", checked);
+    return 0;
+}
@@ -0,0 +1,40 @@
+'''
+@file test_lpc_div.py
+
+@brief Host accuracy check of the LPC reciprocal divide
+
+Builds lpc_div_check.c against ATM33xx-5/drivers/timer/lpc_div.h with the
+host C compiler and runs it.
+
+Copyright (C) Atmosic 2024
+'''
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+HERE = os.path.dirname(os.path.abspath(__file__))
+TIMER_DIR = os.path.join(HERE, '..', '..', '..', 'ATM33xx-5', 'drivers',
+                         'timer')
+
+
+class TestLpcDiv(unittest.TestCase):
+    """Compare atm_lpc_div() with a 64-bit divide"""
+
+    def test_against_64bit_divide(self):
+        cc = os.environ.get('CC') or shutil.which('cc') or shutil.which('gcc')
+        if not cc:
+            self.skipTest('no host C compiler')
+        with tempfile.TemporaryDirectory() as tmp:
+            exe = os.path.join(tmp, 'lpc_div_check')
+            subprocess.run([cc, '-std=gnu11', '-O2', '-Wall', '-Werror',
+                            '-I', TIMER_DIR, '-o', exe,
+                            os.path.join(HERE, 'lpc_div_check.c')],
+                           check=True)
+            result = subprocess.run([exe], capture_output=True, text=True)
+        self.assertEqual(result.returncode, 0, result.stdout)
+
+
+if __name__ == '__main__':
+    unittest.main()